@@ -0,0 +1,49 @@
+// env_config.h
+// Tiny getenv helpers so the camera binaries can be tuned from start_all.sh
+// without changing their positional arguments.
+
+#ifndef ENV_CONFIG_H
+#define ENV_CONFIG_H
+
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <vector>
+
+inline std::string env_str(const char* name, const std::string& def = "")
+{
+    const char* v = std::getenv(name);
+    return (v && *v) ? std::string(v) : def;
+}
+
+inline int env_int(const char* name, int def)
+{
+    const char* v = std::getenv(name);
+    return (v && *v) ? std::atoi(v) : def;
+}
+
+inline float env_float(const char* name, float def)
+{
+    const char* v = std::getenv(name);
+    return (v && *v) ? (float)std::atof(v) : def;
+}
+
+// comma separated list, e.g. YOLO_SIZES=320,416,512,640
+inline std::vector<int> env_int_list(const char* name, const std::vector<int>& def)
+{
+    const char* v = std::getenv(name);
+    if (!v || !*v)
+        return def;
+
+    std::vector<int> out;
+    std::stringstream ss(v);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            out.push_back(std::atoi(item.c_str()));
+    }
+    return out.empty() ? def : out;
+}
+
+#endif // ENV_CONFIG_H
@@ -0,0 +1,418 @@
+// frame_bus.cpp
+
+#include "frame_bus.h"
+
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint32_t bus_magic = 0x59384642; // "YV8B"
+static const uint32_t bus_version = 2;
+static const int max_slots = 64; // one bit per slot in a lease's held mask
+static const int max_readers = 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "frame bus needs lock-free 64-bit atomics");
+
+// one per attached reader; the pid lets the publisher take back slots from a reader that was killed
+struct FrameBusLease
+{
+    std::atomic<int32_t> pid;  // 0 free, -1 being reclaimed by the publisher
+    std::atomic<uint64_t> held; // bit i set while the reader holds slot i
+};
+
+struct FrameBusHeader
+{
+    std::atomic<uint32_t> magic; // written last by the publisher
+    uint32_t version;
+    int32_t slot_count;
+    int32_t width;
+    int32_t height;
+    int32_t type;
+    uint64_t slot_bytes;
+    uint64_t data_offset;
+    // newest frame as (seq << 8) | slot, one word so readers see a consistent pair
+    std::atomic<uint64_t> latest;
+    // low 32 bits of seq, futex word readers sleep on
+    std::atomic<uint32_t> wake;
+    std::atomic<uint64_t> dropped;
+    FrameBusLease leases[max_readers];
+};
+
+struct FrameBusSlot
+{
+    std::atomic<uint64_t> seq; // 0 while the publisher owns it
+    uint64_t frame_id;
+    int64_t ts_ns;
+};
+
+static int64_t monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static FrameBusSlot* slot_at(FrameBusHeader* h, int i)
+{
+    return reinterpret_cast<FrameBusSlot*>(reinterpret_cast<char*>(h) + sizeof(FrameBusHeader)) + i;
+}
+
+static unsigned char* slot_data(FrameBusHeader* h, int i)
+{
+    return reinterpret_cast<unsigned char*>(h) + h->data_offset + i * h->slot_bytes;
+}
+
+// slots held by any reader, dead ones included until reclaimed
+static uint64_t held_mask(FrameBusHeader* h)
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < max_readers; i++)
+        mask |= h->leases[i].held.load();
+    return mask;
+}
+
+static bool process_dead(int32_t pid)
+{
+    return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+// frees the leases of readers that exited without release(), e.g. on SIGKILL
+static int reclaim_dead_readers(FrameBusHeader* h)
+{
+    int reclaimed = 0;
+    for (int i = 0; i < max_readers; i++)
+    {
+        FrameBusLease& lease = h->leases[i];
+        int32_t pid = lease.pid.load();
+        if (!process_dead(pid))
+            continue;
+
+        // -1 keeps a new reader from claiming the lease while its mask is cleared
+        if (!lease.pid.compare_exchange_strong(pid, -1))
+            continue;
+        lease.held.store(0);
+        lease.pid.store(0);
+        reclaimed++;
+    }
+    return reclaimed;
+}
+
+// shared (not process private) futex on the header's wake word
+static void futex_wake_all(std::atomic<uint32_t>* word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms)
+{
+    timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+FrameBusPublisher::FrameBusPublisher() : base(nullptr), map_bytes(0), slot_bytes(0), next_slot(0), header(nullptr)
+{
+}
+
+FrameBusPublisher::~FrameBusPublisher()
+{
+    close();
+}
+
+bool FrameBusPublisher::open(const std::string& _name, int width, int height, int type, int slots)
+{
+    close();
+
+    if (slots < 2 || slots > max_slots)
+        return false;
+
+    name = _name;
+    slot_bytes = ((size_t)width * height * CV_ELEM_SIZE(type) + 63) / 64 * 64;
+    size_t data_offset = (sizeof(FrameBusHeader) + slots * sizeof(FrameBusSlot) + 4095) / 4096 * 4096;
+    map_bytes = data_offset + slots * slot_bytes;
+
+    // a fresh segment each start, a reader still mapping the old one re-attaches
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, map_bytes) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    base = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        base = nullptr;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header = new (base) FrameBusHeader;
+    header->magic.store(0);
+    header->slot_count = slots;
+    header->width = width;
+    header->height = height;
+    header->type = type;
+    header->slot_bytes = slot_bytes;
+    header->data_offset = data_offset;
+    header->latest.store(0);
+    header->wake.store(0);
+    header->dropped.store(0);
+    for (int i = 0; i < max_readers; i++)
+    {
+        header->leases[i].pid.store(0);
+        header->leases[i].held.store(0);
+    }
+    for (int i = 0; i < slots; i++)
+    {
+        FrameBusSlot* s = new (slot_at(header, i)) FrameBusSlot;
+        s->seq.store(0);
+        s->frame_id = 0;
+        s->ts_ns = 0;
+    }
+    header->version = bus_version;
+    // readers check the magic first, so they never see a half initialised header
+    header->magic.store(bus_magic, std::memory_order_release);
+
+    next_slot = 0;
+    return true;
+}
+
+void FrameBusPublisher::close()
+{
+    if (!base)
+        return;
+
+    munmap(base, map_bytes);
+    shm_unlink(name.c_str());
+    base = nullptr;
+    header = nullptr;
+}
+
+bool FrameBusPublisher::publish(const cv::Mat& frame, uint64_t frame_id)
+{
+    if (!header || frame.cols != header->width || frame.rows != header->height || frame.type() != header->type)
+        return false;
+
+    uint64_t latest = header->latest.load(std::memory_order_acquire);
+    int latest_slot = (latest == 0) ? -1 : (int)(latest & 0xff);
+    uint64_t seq = (latest >> 8) + 1;
+
+    // claim a slot: mark it as being written, then make sure no reader got in first.
+    // A reader sets its held bit before checking seq, so one of the two always backs off.
+    // Only when every slot is held are dead readers looked for, then the scan runs once more.
+    FrameBusSlot* slot = nullptr;
+    int index = -1;
+    for (int pass = 0; pass < 2 && !slot; pass++)
+    {
+        if (pass == 1 && reclaim_dead_readers(header) == 0)
+            break;
+
+        for (int n = 0; n < header->slot_count; n++)
+        {
+            int i = (next_slot + n) % header->slot_count;
+            uint64_t bit = 1ull << i;
+            if (i == latest_slot || (held_mask(header) & bit))
+                continue;
+
+            FrameBusSlot* s = slot_at(header, i);
+            uint64_t old_seq = s->seq.exchange(0);
+            if (held_mask(header) & bit)
+            {
+                s->seq.store(old_seq);
+                continue;
+            }
+
+            slot = s;
+            index = i;
+            break;
+        }
+    }
+
+    if (!slot)
+    {
+        header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    next_slot = (index + 1) % header->slot_count;
+
+    unsigned char* dst = slot_data(header, index);
+    size_t row_bytes = frame.cols * frame.elemSize();
+    if (frame.isContinuous())
+    {
+        memcpy(dst, frame.data, row_bytes * frame.rows);
+    }
+    else
+    {
+        for (int y = 0; y < frame.rows; y++)
+            memcpy(dst + y * row_bytes, frame.ptr<unsigned char>(y), row_bytes);
+    }
+
+    slot->frame_id = frame_id;
+    slot->ts_ns = monotonic_ns();
+    slot->seq.store(seq, std::memory_order_release);
+    header->latest.store((seq << 8) | (uint64_t)index, std::memory_order_release);
+
+    header->wake.store((uint32_t)seq, std::memory_order_release);
+    futex_wake_all(&header->wake);
+
+    return true;
+}
+
+uint64_t FrameBusPublisher::dropped() const
+{
+    return header ? header->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+FrameBusReader::FrameBusReader() : base(nullptr), map_bytes(0), last_seq(0), lease(nullptr), header(nullptr)
+{
+}
+
+FrameBusReader::~FrameBusReader()
+{
+    detach();
+}
+
+bool FrameBusReader::attach(const std::string& name)
+{
+    detach();
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FrameBusHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // read-write: readers update their lease
+    map_bytes = st.st_size;
+    base = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        base = nullptr;
+        return false;
+    }
+
+    header = reinterpret_cast<FrameBusHeader*>(base);
+    if (header->magic.load(std::memory_order_acquire) != bus_magic || header->version != bus_version
+            || header->data_offset + header->slot_count * header->slot_bytes > map_bytes)
+    {
+        detach();
+        return false;
+    }
+
+    // take a free lease, or the one of a reader that died without detaching
+    int32_t self = getpid();
+    for (int i = 0; i < max_readers && !lease; i++)
+    {
+        FrameBusLease& l = header->leases[i];
+        int32_t pid = l.pid.load();
+        if ((pid == 0 || process_dead(pid)) && l.pid.compare_exchange_strong(pid, self))
+        {
+            l.held.store(0);
+            lease = &l;
+        }
+    }
+    if (!lease)
+    {
+        detach();
+        return false;
+    }
+
+    last_seq = 0;
+    return true;
+}
+
+void FrameBusReader::detach()
+{
+    if (!base)
+        return;
+
+    if (lease)
+    {
+        lease->held.store(0);
+        lease->pid.store(0);
+        lease = nullptr;
+    }
+    munmap(base, map_bytes);
+    base = nullptr;
+    header = nullptr;
+}
+
+bool FrameBusReader::acquire(FrameView& view, int timeout_ms)
+{
+    if (!header)
+        return false;
+
+    int64_t deadline = monotonic_ns() + (int64_t)timeout_ms * 1000000LL;
+    for (;;)
+    {
+        uint32_t wake = header->wake.load(std::memory_order_acquire);
+        uint64_t latest = header->latest.load(std::memory_order_acquire);
+        uint64_t seq = latest >> 8;
+
+        if (seq == 0 || seq == last_seq)
+        {
+            int64_t left_ms = (deadline - monotonic_ns()) / 1000000LL;
+            if (left_ms <= 0)
+                return false;
+            futex_wait(&header->wake, wake, (int)left_ms);
+            continue;
+        }
+
+        int index = (int)(latest & 0xff);
+        FrameBusSlot* slot = slot_at(header, index);
+        uint64_t bit = 1ull << index;
+        lease->held.fetch_or(bit);
+        if (slot->seq.load() != seq)
+        {
+            // overwritten between reading latest and taking the slot, try the newer one
+            lease->held.fetch_and(~bit);
+            continue;
+        }
+
+        view.mat = cv::Mat(header->height, header->width, header->type, slot_data(header, index));
+        view.seq = seq;
+        view.frame_id = slot->frame_id;
+        view.ts_ns = slot->ts_ns;
+        view.slot = index;
+        last_seq = seq;
+        return true;
+    }
+}
+
+void FrameBusReader::release(FrameView& view)
+{
+    if (!header || view.slot < 0)
+        return;
+
+    view.mat.release();
+    lease->held.fetch_and(~(1ull << view.slot), std::memory_order_release);
+    view.slot = -1;
+}
+
+uint64_t FrameBusReader::publisher_dropped() const
+{
+    return header ? header->dropped.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,87 @@
+// frame_bus.h
+// Shared-memory frame ring: one capture process publishes, any number of
+// detector / recorder / preview processes read the frames in place.
+//
+// The publisher copies each frame once into a free slot and never waits:
+// slots a reader still holds are skipped, and when every slot is held the
+// frame is dropped and counted. Readers always jump to the newest frame, so
+// a slow reader only loses frames itself. Size the ring with at least
+// readers + 2 slots; up to 16 readers can attach at once.
+//
+// Each reader holds a lease stamped with its pid. When every slot is held the
+// publisher checks those pids and takes back the slots of readers that were
+// killed while holding a frame, so a kill -9 does not leak a slot.
+
+#ifndef FRAME_BUS_H
+#define FRAME_BUS_H
+
+#include <opencv2/core/core.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct FrameBusHeader;
+struct FrameBusSlot;
+struct FrameBusLease;
+
+struct FrameView
+{
+    FrameView() : seq(0), frame_id(0), ts_ns(0), slot(-1) {}
+
+    cv::Mat mat;       // points into shared memory, valid until release()
+    uint64_t seq;      // publish counter, gaps mean this reader skipped frames
+    uint64_t frame_id; // publisher's frame id
+    int64_t ts_ns;     // CLOCK_MONOTONIC at publish, comparable across processes
+    int slot;
+};
+
+class FrameBusPublisher
+{
+public:
+    FrameBusPublisher();
+    ~FrameBusPublisher();
+
+    // name like "/yolo_video0"; creates (or recreates) the segment
+    bool open(const std::string& name, int width, int height, int type, int slots = 8);
+    void close();
+
+    // copies frame into a free slot, false when all slots are held (dropped)
+    bool publish(const cv::Mat& frame, uint64_t frame_id);
+
+    uint64_t dropped() const;
+    size_t frame_bytes() const { return slot_bytes; }
+
+private:
+    std::string name;
+    void* base;
+    size_t map_bytes;
+    size_t slot_bytes;
+    int next_slot;
+    FrameBusHeader* header;
+};
+
+class FrameBusReader
+{
+public:
+    FrameBusReader();
+    ~FrameBusReader();
+
+    // attach() again to follow a restarted publisher, it recreates the segment
+    bool attach(const std::string& name);
+    void detach();
+
+    // waits up to timeout_ms for a frame newer than the last one acquired
+    bool acquire(FrameView& view, int timeout_ms = 100);
+    void release(FrameView& view);
+
+    uint64_t publisher_dropped() const;
+
+private:
+    void* base;
+    size_t map_bytes;
+    uint64_t last_seq;
+    FrameBusLease* lease;
+    FrameBusHeader* header;
+};
+
+#endif // FRAME_BUS_H
@@ -0,0 +1,236 @@
+// frame_trace.cpp
+
+#include "frame_trace.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace_on(false);
+
+struct TraceEvent
+{
+    const char* name;
+    uint64_t frame;
+    int64_t begin_ns;
+    int64_t dur_ns;
+    bool async;
+};
+
+struct TraceRing
+{
+    std::string thread;
+    int tid;
+    std::vector<TraceEvent> events;
+    size_t mask;
+    // events written so far; the slot is filled before head moves past it
+    std::atomic<uint64_t> head;
+};
+
+static std::mutex rings_mutex;
+static std::vector<std::unique_ptr<TraceRing>> rings;
+static size_t ring_size = 1 << 16;
+static std::atomic<uint64_t> next_frame(1);
+static std::atomic<uint64_t> unnamed_dropped(0);
+static thread_local TraceRing* local_ring = nullptr;
+
+void trace_start(size_t events_per_thread)
+{
+    size_t n = 1;
+    while (n < events_per_thread)
+        n <<= 1;
+
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    ring_size = n;
+    trace_on.store(true, std::memory_order_release);
+}
+
+void trace_stop()
+{
+    trace_on.store(false, std::memory_order_release);
+}
+
+static TraceRing* create_ring(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    TraceRing* ring = new TraceRing;
+    ring->tid = (int)rings.size() + 1;
+    ring->thread = name;
+    ring->events.resize(ring_size);
+    ring->mask = ring_size - 1;
+    ring->head.store(0);
+    rings.emplace_back(ring);
+    return ring;
+}
+
+void trace_thread_name(const std::string& name)
+{
+    if (local_ring)
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        local_ring->thread = name;
+    }
+    else if (trace_enabled())
+    {
+        local_ring = create_ring(name);
+    }
+}
+
+uint64_t trace_new_frame()
+{
+    return trace_enabled() ? next_frame.fetch_add(1, std::memory_order_relaxed) : 0;
+}
+
+int64_t trace_now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void record(const char* name, uint64_t frame, int64_t begin_ns, int64_t end_ns, bool async)
+{
+    // rings are allocated up front by trace_thread_name(), a span is only a store
+    TraceRing* ring = local_ring;
+    if (!ring)
+    {
+        unnamed_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t h = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& e = ring->events[h & ring->mask];
+    e.name = name;
+    e.frame = frame;
+    e.begin_ns = begin_ns;
+    e.dur_ns = end_ns - begin_ns;
+    e.async = async;
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+void trace_complete(const char* name, uint64_t frame, int64_t begin_ns, int64_t end_ns)
+{
+    if (trace_enabled())
+        record(name, frame, begin_ns, end_ns, false);
+}
+
+void trace_async(const char* name, uint64_t frame, int64_t begin_ns, int64_t end_ns)
+{
+    if (trace_enabled())
+        record(name, frame, begin_ns, end_ns, true);
+}
+
+void trace_sequence(uint64_t frame, int64_t begin_ns, std::initializer_list<std::pair<const char*, float>> stages_ms)
+{
+    if (!trace_enabled())
+        return;
+
+    int64_t t = begin_ns;
+    for (const auto& s : stages_ms)
+    {
+        int64_t end = t + (int64_t)(s.second * 1e6f);
+        record(s.first, frame, t, end, false);
+        t = end;
+    }
+}
+
+struct DumpEvent
+{
+    const TraceEvent* e;
+    int tid;
+};
+
+bool trace_dump(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    uint64_t dropped = unnamed_dropped.load(std::memory_order_relaxed);
+    if (dropped)
+        fprintf(stderr, "trace: %llu spans from threads without trace_thread_name() dropped\n", (unsigned long long)dropped);
+
+    // copy out each ring, dropping slots the writer may have reused while we copied
+    std::vector<std::vector<TraceEvent>> copies(rings.size());
+    int64_t t_origin = INT64_MAX;
+    for (size_t r = 0; r < rings.size(); r++)
+    {
+        TraceRing* ring = rings[r].get();
+        uint64_t end = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = end > ring->events.size() ? end - ring->events.size() : 0;
+        for (uint64_t i = begin; i < end; i++)
+            copies[r].push_back(ring->events[i & ring->mask]);
+
+        uint64_t after = ring->head.load(std::memory_order_acquire);
+        size_t stale = 0;
+        if (after > ring->events.size())
+        {
+            uint64_t safe = after - ring->events.size() + 1;
+            stale = (size_t)std::min<uint64_t>(safe > begin ? safe - begin : 0, copies[r].size());
+        }
+        copies[r].erase(copies[r].begin(), copies[r].begin() + stale);
+
+        for (const TraceEvent& e : copies[r])
+            t_origin = std::min(t_origin, e.begin_ns);
+    }
+    if (t_origin == INT64_MAX)
+        t_origin = 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"yolov8\"}}");
+
+    std::map<uint64_t, std::vector<DumpEvent>> frames;
+    for (size_t r = 0; r < rings.size(); r++)
+    {
+        int tid = rings[r]->tid;
+        fprintf(f, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}", tid, rings[r]->thread.c_str());
+
+        for (const TraceEvent& e : copies[r])
+        {
+            if (e.async)
+            {
+                double ts = (e.begin_ns - t_origin) / 1000.0;
+                fprintf(f, ",\n{\"ph\":\"b\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"cat\":\"%s\",\"id\":%llu,\"ts\":%.3f,\"args\":{\"frame\":%llu}}",
+                        tid, e.name, e.name, (unsigned long long)e.frame, ts, (unsigned long long)e.frame);
+                fprintf(f, ",\n{\"ph\":\"e\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"cat\":\"%s\",\"id\":%llu,\"ts\":%.3f}",
+                        tid, e.name, e.name, (unsigned long long)e.frame, ts + e.dur_ns / 1000.0);
+                continue;
+            }
+            fprintf(f, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                    tid, e.name, (e.begin_ns - t_origin) / 1000.0, e.dur_ns / 1000.0, (unsigned long long)e.frame);
+            if (e.frame)
+                frames[e.frame].push_back(DumpEvent{&e, tid});
+        }
+    }
+
+    // one flow per frame, with a step wherever the frame moves to another thread
+    for (auto& fr : frames)
+    {
+        std::vector<DumpEvent>& ev = fr.second;
+        std::sort(ev.begin(), ev.end(), [](const DumpEvent& a, const DumpEvent& b) { return a.e->begin_ns < b.e->begin_ns; });
+
+        std::vector<DumpEvent> hops;
+        for (const DumpEvent& d : ev)
+            if (hops.empty() || hops.back().tid != d.tid)
+                hops.push_back(d);
+        if (hops.size() < 2)
+            continue;
+
+        for (size_t i = 0; i < hops.size(); i++)
+        {
+            const char* ph = (i == 0) ? "s" : (i + 1 == hops.size()) ? "f" : "t";
+            fprintf(f, ",\n{\"ph\":\"%s\",\"bp\":\"e\",\"pid\":1,\"tid\":%d,\"name\":\"frame\",\"cat\":\"frame\",\"id\":%llu,\"ts\":%.3f}",
+                    ph, hops[i].tid, (unsigned long long)fr.first, (hops[i].e->begin_ns - t_origin) / 1000.0);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
@@ -0,0 +1,77 @@
+// frame_trace.h
+// Opt-in per-frame tracing, dumped as Chrome trace / Perfetto JSON
+// (open in ui.perfetto.dev or chrome://tracing).
+//
+// Each frame gets an id at capture that travels with it through detection,
+// the results queue and the logger. Spans are recorded as complete events
+// into a fixed ring per thread, allocated by trace_thread_name() before the
+// thread's loop: two clock reads and a store, no locks, no allocation and no
+// I/O per span, so tracing can stay on at full frame rate. Waits that start on one thread and end on another (the
+// results queue) are async spans on their own track. The rings keep the
+// most recent events per thread and are written out by trace_dump(),
+// normally once at exit. The dump links the spans of one frame across
+// threads with flow arrows.
+//
+// While tracing is off every call returns after one relaxed load.
+
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+extern std::atomic<bool> trace_on;
+
+inline bool trace_enabled()
+{
+    return trace_on.load(std::memory_order_relaxed);
+}
+
+// events_per_thread is rounded up to a power of two, 40 bytes each
+void trace_start(size_t events_per_thread = 1 << 16);
+void trace_stop();
+
+// label for the calling thread's track; call after trace_start() and before
+// the thread's loop, it allocates the ring. Spans of a thread without one
+// are dropped and counted in the dump
+void trace_thread_name(const std::string& name);
+
+// unique id for a newly captured frame, 0 while tracing is off
+uint64_t trace_new_frame();
+
+// CLOCK_MONOTONIC in ns, the same clock as FrameView::ts_ns
+int64_t trace_now_ns();
+
+// name must be a string literal, only the pointer is stored
+void trace_complete(const char* name, uint64_t frame, int64_t begin_ns, int64_t end_ns);
+
+// span that crosses threads, e.g. time spent in a queue; recorded by either side
+void trace_async(const char* name, uint64_t frame, int64_t begin_ns, int64_t end_ns);
+
+// stage times measured elsewhere (YoloV8::last_timings), laid end to end from begin_ns
+void trace_sequence(uint64_t frame, int64_t begin_ns, std::initializer_list<std::pair<const char*, float>> stages_ms);
+
+// writes every thread's ring; spans recorded meanwhile may be left out
+bool trace_dump(const std::string& path);
+
+class TraceSpan
+{
+public:
+    TraceSpan(const char* _name, uint64_t _frame) : name(_name), frame(_frame), begin_ns(trace_enabled() ? trace_now_ns() : 0) {}
+    ~TraceSpan()
+    {
+        if (begin_ns)
+            trace_complete(name, frame, begin_ns, trace_now_ns());
+    }
+
+private:
+    const char* name;
+    uint64_t frame;
+    int64_t begin_ns;
+};
+
+#endif // FRAME_TRACE_H
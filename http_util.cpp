@@ -0,0 +1,105 @@
+// http_util.cpp
+
+#include "http_util.h"
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int http_listen(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int http_accept(int listen_fd, int timeout_ms)
+{
+    pollfd p = {listen_fd, POLLIN, 0};
+    if (poll(&p, 1, timeout_ms) <= 0)
+        return -1;
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool http_read_request(int fd, std::string& path, int timeout_ms)
+{
+    std::string head;
+    char buf[512];
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < 8192)
+    {
+        pollfd p = {fd, POLLIN, 0};
+        if (poll(&p, 1, timeout_ms) <= 0)
+            return false;
+
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            return false;
+        head.append(buf, n);
+    }
+
+    if (head.compare(0, 4, "GET ") != 0)
+        return false;
+
+    size_t end = head.find(' ', 4);
+    if (end == std::string::npos)
+        return false;
+
+    path = head.substr(4, end - 4);
+    return true;
+}
+
+bool http_send_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+long http_send_some(int fd, const char* data, size_t size)
+{
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    return n;
+}
+
+void http_close(int fd)
+{
+    if (fd >= 0)
+        close(fd);
+}
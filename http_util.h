@@ -0,0 +1,27 @@
+// http_util.h
+// Just enough HTTP/1.0 for the local preview and metrics endpoints.
+
+#ifndef HTTP_UTIL_H
+#define HTTP_UTIL_H
+
+#include <cstddef>
+#include <string>
+
+// listening TCP socket on all interfaces, -1 on failure
+int http_listen(int port);
+
+// waits up to timeout_ms for a client, -1 on timeout or error
+int http_accept(int listen_fd, int timeout_ms);
+
+// reads the request head and returns the path of "GET <path> HTTP/1.x"
+bool http_read_request(int fd, std::string& path, int timeout_ms = 1000);
+
+// blocking send of the whole buffer, false when the peer went away
+bool http_send_all(int fd, const char* data, size_t size);
+
+// non-blocking send, returns bytes written (0 when the socket is full), -1 on error
+long http_send_some(int fd, const char* data, size_t size);
+
+void http_close(int fd);
+
+#endif // HTTP_UTIL_H
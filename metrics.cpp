@@ -0,0 +1,271 @@
+// metrics.cpp
+
+#include "metrics.h"
+#include "http_util.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+static const char* const stage_names[STAGE_COUNT] = {
+    "capture", "preprocess", "inference", "decode", "nms", "queue_wait", "log_write"};
+
+static const char* const counter_names[COUNTER_COUNT] = {
+    "yolo_frames_total", "yolo_humans_total", "yolo_frames_skipped_total", "yolo_queue_dropped_total"};
+
+static const char* const counter_help[COUNTER_COUNT] = {
+    "Frames run through the detector.",
+    "Persons detected.",
+    "Frames published on the frame bus that this reader never saw.",
+    "Results dropped because the logger queue was full."};
+
+const char* stage_name(MetricStage stage)
+{
+    return stage_names[stage];
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (int i = 0; i < bucket_count; i++)
+        counts[i].store(0);
+    total.store(0);
+    sum.store(0);
+}
+
+int LatencyHistogram::bucket_of(uint64_t us)
+{
+    const uint64_t max_us = (2ull << max_exponent) - 1;
+    if (us > max_us)
+        us = max_us;
+    if (us < (1u << sub_bits))
+        return (int)us;
+
+    int exponent = 63 - __builtin_clzll(us);
+    int sub = (int)(us >> (exponent - sub_bits)) & ((1 << sub_bits) - 1);
+    return ((exponent - sub_bits + 1) << sub_bits) + sub;
+}
+
+uint64_t LatencyHistogram::bucket_lower_us(int b)
+{
+    if (b < (1 << sub_bits))
+        return b;
+
+    int exponent = (b >> sub_bits) + sub_bits - 1;
+    uint64_t sub = b & ((1 << sub_bits) - 1);
+    return ((1ull << sub_bits) + sub) << (exponent - sub_bits);
+}
+
+void LatencyHistogram::record_us(uint64_t us)
+{
+    // one writer per histogram: plain load + store instead of a locked add
+    std::atomic<uint64_t>& c = counts[bucket_of(us)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+    total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::quantile_us(double q) const
+{
+    uint64_t n = 0;
+    uint64_t snapshot[bucket_count];
+    for (int b = 0; b < bucket_count; b++)
+    {
+        snapshot[b] = bucket(b);
+        n += snapshot[b];
+    }
+    if (n == 0)
+        return 0.0;
+
+    uint64_t rank = (uint64_t)(q * n + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > n)
+        rank = n;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < bucket_count; b++)
+    {
+        seen += snapshot[b];
+        if (seen >= rank)
+        {
+            // middle of the bucket
+            double lo = (double)bucket_lower_us(b);
+            double hi = (b + 1 < bucket_count) ? (double)bucket_lower_us(b + 1) : lo * 2.0;
+            return (lo + hi) * 0.5;
+        }
+    }
+    return (double)bucket_lower_us(bucket_count - 1);
+}
+
+ThreadMetrics* MetricsRegistry::add_thread(const std::string& thread)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.emplace_back(new ThreadMetrics(thread));
+    return threads.back().get();
+}
+
+void MetricsRegistry::add_gauge(const std::string& name, const std::string& labels, std::function<double()> value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    gauges.push_back(Gauge{name, labels, value});
+}
+
+static void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(std::string& out, const char* fmt, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > 0)
+        out.append(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+std::string MetricsRegistry::render() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out;
+    out.reserve(64 * 1024);
+
+    // exported buckets: 2 per power of two from 32 us, the full resolution goes into the quantiles
+    std::vector<int> edges;
+    for (int b = 3 << LatencyHistogram::sub_bits; b < LatencyHistogram::bucket_count; b += 1 << (LatencyHistogram::sub_bits - 1))
+        edges.push_back(b);
+
+    out += "# HELP yolo_stage_latency_seconds Pipeline stage latency per thread.\n";
+    out += "# TYPE yolo_stage_latency_seconds histogram\n";
+    for (const auto& t : threads)
+    {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            const LatencyHistogram& h = t->stage((MetricStage)s);
+            if (h.count() == 0)
+                continue;
+
+            const char* th = t->thread().c_str();
+            uint64_t cumulative = 0;
+            int b = 0;
+            for (int edge : edges)
+            {
+                // buckets below edge hold whole microseconds up to one less than edge's lower bound,
+                // that is the inclusive "le"; a sample equal to the lower bound belongs to the next line
+                for (; b < edge; b++)
+                    cumulative += h.bucket(b);
+                append(out, "yolo_stage_latency_seconds_bucket{thread=\"%s\",stage=\"%s\",le=\"%.9g\"} %llu\n",
+                       th, stage_names[s], (LatencyHistogram::bucket_lower_us(edge) - 1) * 1e-6, (unsigned long long)cumulative);
+            }
+            for (; b < LatencyHistogram::bucket_count; b++)
+                cumulative += h.bucket(b);
+            append(out, "yolo_stage_latency_seconds_bucket{thread=\"%s\",stage=\"%s\",le=\"+Inf\"} %llu\n",
+                   th, stage_names[s], (unsigned long long)cumulative);
+            append(out, "yolo_stage_latency_seconds_sum{thread=\"%s\",stage=\"%s\"} %.6f\n", th, stage_names[s], h.sum_us() * 1e-6);
+            append(out, "yolo_stage_latency_seconds_count{thread=\"%s\",stage=\"%s\"} %llu\n", th, stage_names[s], (unsigned long long)cumulative);
+        }
+    }
+
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    out += "# HELP yolo_stage_latency_quantile_seconds Stage latency quantiles since start, from the full-resolution histogram.\n";
+    out += "# TYPE yolo_stage_latency_quantile_seconds gauge\n";
+    for (const auto& t : threads)
+    {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            const LatencyHistogram& h = t->stage((MetricStage)s);
+            if (h.count() == 0)
+                continue;
+            for (double q : quantiles)
+                append(out, "yolo_stage_latency_quantile_seconds{thread=\"%s\",stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                       t->thread().c_str(), stage_names[s], q, h.quantile_us(q) * 1e-6);
+        }
+    }
+
+    for (int c = 0; c < COUNTER_COUNT; c++)
+    {
+        append(out, "# HELP %s %s\n# TYPE %s counter\n", counter_names[c], counter_help[c], counter_names[c]);
+        for (const auto& t : threads)
+            append(out, "%s{thread=\"%s\"} %llu\n", counter_names[c], t->thread().c_str(), (unsigned long long)t->counter((MetricCounter)c));
+    }
+
+    std::string last;
+    for (const Gauge& g : gauges)
+    {
+        if (g.name != last)
+        {
+            append(out, "# TYPE %s gauge\n", g.name.c_str());
+            last = g.name;
+        }
+        append(out, "%s{%s} %g\n", g.name.c_str(), g.labels.c_str(), g.value());
+    }
+
+    return out;
+}
+
+MetricsRegistry& metrics_registry()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsServer::MetricsServer() : listen_fd(-1), running(false)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(int port)
+{
+    stop();
+
+    listen_fd = http_listen(port);
+    if (listen_fd < 0)
+        return false;
+
+    running = true;
+    serve_thread = std::thread(&MetricsServer::serve_loop, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!running)
+        return;
+
+    running = false;
+    serve_thread.join();
+    http_close(listen_fd);
+    listen_fd = -1;
+}
+
+void MetricsServer::serve_loop()
+{
+    while (running)
+    {
+        int fd = http_accept(listen_fd, 200);
+        if (fd < 0)
+            continue;
+
+        std::string path;
+        if (http_read_request(fd, path))
+        {
+            std::string body, head;
+            if (path == "/metrics")
+            {
+                body = metrics_registry().render();
+                head = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+            }
+            else
+            {
+                body = "try /metrics\n";
+                head = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+            }
+            head += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+            if (http_send_all(fd, head.data(), head.size()))
+                http_send_all(fd, body.data(), body.size());
+        }
+        http_close(fd);
+    }
+}
@@ -0,0 +1,186 @@
+// mjpeg_server.cpp
+
+#include "mjpeg_server.h"
+#include "http_util.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <chrono>
+#include <cstdio>
+
+static const char stream_head[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n\r\n";
+
+MjpegServer::MjpegServer() : listen_fd(-1), quality(75), running(false), viewers(0), has_pending(false)
+{
+}
+
+MjpegServer::~MjpegServer()
+{
+    stop();
+}
+
+bool MjpegServer::start(int port, int jpeg_quality)
+{
+    stop();
+
+    listen_fd = http_listen(port);
+    if (listen_fd < 0)
+        return false;
+
+    quality = jpeg_quality;
+    running = true;
+    accept_thread = std::thread(&MjpegServer::accept_loop, this);
+    render_thread = std::thread(&MjpegServer::render_loop, this);
+    return true;
+}
+
+void MjpegServer::stop()
+{
+    if (!running)
+        return;
+
+    running = false;
+    pending_cv.notify_all();
+    accept_thread.join();
+    render_thread.join();
+
+    http_close(listen_fd);
+    listen_fd = -1;
+
+    for (size_t i = 0; i < clients.size(); i++)
+        http_close(clients[i].fd);
+    for (size_t i = 0; i < new_clients.size(); i++)
+        http_close(new_clients[i]);
+    clients.clear();
+    new_clients.clear();
+    viewers = 0;
+}
+
+void MjpegServer::submit(const cv::Mat& frame, const std::vector<Object>& objects, const std::string& overlay)
+{
+    if (!has_viewers())
+        return;
+
+    // the render thread holds this lock only to swap buffers; if it is taken, skip the frame
+    std::unique_lock<std::mutex> lock(pending_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    frame.copyTo(pending_frame);
+    pending_objects = objects;
+    pending_overlay = overlay;
+    has_pending = true;
+    lock.unlock();
+
+    pending_cv.notify_one();
+}
+
+void MjpegServer::accept_loop()
+{
+    while (running)
+    {
+        int fd = http_accept(listen_fd, 200);
+        if (fd < 0)
+            continue;
+
+        std::string path;
+        if (!http_read_request(fd, path) || !http_send_all(fd, stream_head, sizeof(stream_head) - 1))
+        {
+            http_close(fd);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        new_clients.push_back(fd);
+        viewers++;
+    }
+}
+
+void MjpegServer::flush_clients(const std::shared_ptr<const std::vector<unsigned char>>& next)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex);
+
+    for (size_t i = 0; i < new_clients.size(); i++)
+        clients.push_back(Client{new_clients[i], nullptr, 0});
+    new_clients.clear();
+
+    for (size_t i = 0; i < clients.size();)
+    {
+        Client& c = clients[i];
+
+        // a client still sending an older frame keeps it and misses this one
+        if ((!c.part || c.sent == c.part->size()) && next)
+        {
+            c.part = next;
+            c.sent = 0;
+        }
+
+        long n = 0;
+        if (c.part && c.sent < c.part->size())
+            n = http_send_some(c.fd, (const char*)c.part->data() + c.sent, c.part->size() - c.sent);
+
+        if (n < 0)
+        {
+            http_close(c.fd);
+            clients.erase(clients.begin() + i);
+            viewers--;
+            continue;
+        }
+        c.sent += n;
+        i++;
+    }
+}
+
+void MjpegServer::render_loop()
+{
+    cv::Mat frame;
+    std::vector<Object> objects;
+    std::string overlay;
+    std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, quality};
+
+    while (running)
+    {
+        bool have = false;
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex);
+            // wake up now and then to push out partially sent frames
+            pending_cv.wait_for(lock, std::chrono::milliseconds(20), [this] { return has_pending || !running; });
+            if (has_pending)
+            {
+                cv::swap(frame, pending_frame);
+                objects.swap(pending_objects);
+                overlay.swap(pending_overlay);
+                has_pending = false;
+                have = true;
+            }
+        }
+
+        std::shared_ptr<std::vector<unsigned char>> part;
+        if (have)
+        {
+            YoloV8::draw(frame, objects);
+            if (!overlay.empty())
+                cv::putText(frame, overlay, cv::Point(20, 40), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 0, 0), 2);
+
+            // encode once, every client gets the same buffer
+            std::vector<unsigned char> jpeg;
+            cv::imencode(".jpg", frame, jpeg, params);
+
+            char head[128];
+            int len = snprintf(head, sizeof(head), "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", jpeg.size());
+
+            part = std::make_shared<std::vector<unsigned char>>();
+            part->reserve(len + jpeg.size() + 2);
+            part->insert(part->end(), head, head + len);
+            part->insert(part->end(), jpeg.begin(), jpeg.end());
+            part->push_back('\r');
+            part->push_back('\n');
+        }
+
+        flush_clients(part);
+    }
+}
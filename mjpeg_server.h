@@ -0,0 +1,69 @@
+// mjpeg_server.h
+// Annotate-and-stream preview off the detector thread.
+// The detector hands over its latest frame and boxes with submit(), which
+// never blocks and does nothing while nobody is watching. A render thread
+// draws the boxes, JPEG-encodes the frame once and fans it out to every
+// connected HTTP client (multipart/x-mixed-replace, opens in any browser).
+// A client that cannot keep up skips frames instead of holding up the rest.
+
+#ifndef MJPEG_SERVER_H
+#define MJPEG_SERVER_H
+
+#include "yoloV8.h"
+#include <opencv2/core/core.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MjpegServer
+{
+public:
+    MjpegServer();
+    ~MjpegServer();
+
+    bool start(int port, int jpeg_quality = 75);
+    void stop();
+
+    bool has_viewers() const { return viewers.load(std::memory_order_relaxed) > 0; }
+
+    // called from the detector thread; copies the frame only when a viewer is
+    // connected and the render thread is not busy with the previous one
+    void submit(const cv::Mat& frame, const std::vector<Object>& objects, const std::string& overlay);
+
+private:
+    struct Client
+    {
+        int fd;
+        std::shared_ptr<const std::vector<unsigned char>> part; // frame being sent
+        size_t sent;
+    };
+
+    void accept_loop();
+    void render_loop();
+    void flush_clients(const std::shared_ptr<const std::vector<unsigned char>>& next);
+
+    int listen_fd;
+    int quality;
+    std::atomic<bool> running;
+    std::atomic<int> viewers;
+    std::thread accept_thread;
+    std::thread render_thread;
+
+    // latest submitted frame, handed from the detector to the render thread
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    cv::Mat pending_frame;
+    std::vector<Object> pending_objects;
+    std::string pending_overlay;
+    bool has_pending;
+
+    std::mutex clients_mutex;
+    std::vector<Client> clients;
+    std::vector<int> new_clients;
+};
+
+#endif // MJPEG_SERVER_H
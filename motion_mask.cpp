@@ -0,0 +1,46 @@
+// motion_mask.cpp
+
+#include "motion_mask.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+MotionMask::MotionMask(float _scale, int _threshold) : scale(_scale), threshold(_threshold)
+{
+}
+
+const cv::Mat& MotionMask::update(const cv::Mat& frame, const cv::Mat& roi)
+{
+    cv::Mat small, grey;
+    cv::resize(frame, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    cv::cvtColor(small, grey, cv::COLOR_BGR2GRAY);
+
+    if (prev.empty() || prev.size() != grey.size())
+    {
+        mask = cv::Mat(grey.size(), CV_8UC1, cv::Scalar(255));
+    }
+    else
+    {
+        cv::Mat diff;
+        cv::absdiff(grey, prev, diff);
+        cv::threshold(diff, mask, threshold, 255, cv::THRESH_BINARY);
+        // grow the blobs so a person straddling a tile edge wakes both tiles
+        cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+    }
+    prev = grey;
+
+    if (!roi.empty())
+    {
+        cv::Mat roi_small;
+        cv::resize(roi, roi_small, mask.size(), 0, 0, cv::INTER_NEAREST);
+        cv::bitwise_and(mask, roi_small, mask);
+    }
+
+    return mask;
+}
+
+float MotionMask::motion_fraction() const
+{
+    if (mask.empty())
+        return 0.f;
+    return (float)cv::countNonZero(mask) / (mask.cols * mask.rows);
+}
@@ -0,0 +1,30 @@
+// motion_mask.h
+// Cheap frame-difference motion mask at reduced resolution, used to skip
+// tiles in YoloV8::detect_tiled where nothing moved.
+
+#ifndef MOTION_MASK_H
+#define MOTION_MASK_H
+
+#include <opencv2/core/core.hpp>
+
+class MotionMask
+{
+public:
+    // scale: mask resolution relative to the frame, threshold: grey level change
+    MotionMask(float scale = 0.125f, int threshold = 25);
+
+    // returns the 8-bit mask (255 = moved) for frame; the first frame is all
+    // motion. A non-empty roi mask (any resolution) is and-ed in.
+    const cv::Mat& update(const cv::Mat& frame, const cv::Mat& roi = cv::Mat());
+
+    // share of mask pixels that moved in the last update
+    float motion_fraction() const;
+
+private:
+    float scale;
+    int threshold;
+    cv::Mat prev;
+    cv::Mat mask;
+};
+
+#endif // MOTION_MASK_H
@@ -0,0 +1,177 @@
+// ncnn_profile.cpp
+
+#include "ncnn_profile.h"
+
+#include <cpu.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+static std::string trim(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos)
+        return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+static std::string cpu_model()
+{
+    // x86 and most arm64 kernels report "model name", the Pi firmware adds "Model"
+    // (e.g. "Raspberry Pi 4 Model B Rev 1.4") which tells Pi 4 and Pi 5 apart
+    const char* fields[] = {"Model", "model name", "Hardware", "CPU part"};
+
+    std::ifstream f("/proc/cpuinfo");
+    std::string line;
+    std::string found[4];
+    while (std::getline(f, line))
+    {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+
+        std::string name = trim(line.substr(0, colon));
+        for (int i = 0; i < 4; i++)
+        {
+            if (found[i].empty() && name == fields[i])
+                found[i] = trim(line.substr(colon + 1));
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (!found[i].empty())
+            return found[i];
+    }
+    return "unknown";
+}
+
+std::string machine_key(const std::string& model, int nets)
+{
+    std::ostringstream key;
+    key << cpu_model() << "|" << ncnn::get_cpu_count() << "|" << model;
+    if (nets > 1)
+        key << "|x" << nets;
+    return key.str();
+}
+
+void profile_from_option(const ncnn::Option& opt, NcnnProfile& profile)
+{
+    profile.num_threads = opt.num_threads;
+    profile.openmp_blocktime = opt.openmp_blocktime;
+    profile.lightmode = opt.lightmode;
+    profile.use_winograd_convolution = opt.use_winograd_convolution;
+    profile.use_sgemm_convolution = opt.use_sgemm_convolution;
+    profile.use_fp16_packed = opt.use_fp16_packed;
+    profile.use_fp16_storage = opt.use_fp16_storage;
+    profile.use_fp16_arithmetic = opt.use_fp16_arithmetic;
+    profile.use_packing_layout = opt.use_packing_layout;
+    profile.infer_ms = 0.f;
+}
+
+void apply_profile(const NcnnProfile& profile, ncnn::Option& opt)
+{
+    opt.num_threads = profile.num_threads;
+    opt.openmp_blocktime = profile.openmp_blocktime;
+    opt.lightmode = profile.lightmode;
+    opt.use_winograd_convolution = profile.use_winograd_convolution;
+    opt.use_sgemm_convolution = profile.use_sgemm_convolution;
+    opt.use_fp16_packed = profile.use_fp16_packed;
+    opt.use_fp16_storage = profile.use_fp16_storage;
+    opt.use_fp16_arithmetic = profile.use_fp16_arithmetic;
+    opt.use_packing_layout = profile.use_packing_layout;
+}
+
+std::string profile_to_string(const NcnnProfile& p)
+{
+    std::ostringstream s;
+    s << "num_threads=" << p.num_threads
+      << " openmp_blocktime=" << p.openmp_blocktime
+      << " lightmode=" << p.lightmode
+      << " winograd=" << p.use_winograd_convolution
+      << " sgemm=" << p.use_sgemm_convolution
+      << " fp16_packed=" << p.use_fp16_packed
+      << " fp16_storage=" << p.use_fp16_storage
+      << " fp16_arithmetic=" << p.use_fp16_arithmetic
+      << " packing_layout=" << p.use_packing_layout
+      << " infer_ms=" << p.infer_ms;
+    return s.str();
+}
+
+static bool profile_from_string(const std::string& text, NcnnProfile& p)
+{
+    // start from ncnn defaults so older files missing a field still load
+    profile_from_option(ncnn::Option(), p);
+
+    int fields = 0;
+    std::istringstream s(text);
+    std::string kv;
+    while (s >> kv)
+    {
+        size_t eq = kv.find('=');
+        if (eq == std::string::npos)
+            return false;
+
+        std::string k = kv.substr(0, eq);
+        float v = (float)atof(kv.c_str() + eq + 1);
+
+        if (k == "num_threads") p.num_threads = (int)v;
+        else if (k == "openmp_blocktime") p.openmp_blocktime = (int)v;
+        else if (k == "lightmode") p.lightmode = v != 0.f;
+        else if (k == "winograd") p.use_winograd_convolution = v != 0.f;
+        else if (k == "sgemm") p.use_sgemm_convolution = v != 0.f;
+        else if (k == "fp16_packed") p.use_fp16_packed = v != 0.f;
+        else if (k == "fp16_storage") p.use_fp16_storage = v != 0.f;
+        else if (k == "fp16_arithmetic") p.use_fp16_arithmetic = v != 0.f;
+        else if (k == "packing_layout") p.use_packing_layout = v != 0.f;
+        else if (k == "infer_ms") p.infer_ms = v;
+        else continue;
+
+        fields++;
+    }
+
+    return fields > 0 && p.num_threads > 0;
+}
+
+bool load_profile(const char* path, const std::string& key, NcnnProfile& profile)
+{
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line))
+    {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(0, tab, key) != 0 || tab != key.size())
+            continue;
+
+        return profile_from_string(line.substr(tab + 1), profile);
+    }
+    return false;
+}
+
+bool save_profile(const char* path, const std::string& key, const NcnnProfile& profile)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream f(path);
+        std::string line;
+        while (std::getline(f, line))
+        {
+            if (line.empty() || line.compare(0, key.size() + 1, key + "\t") == 0)
+                continue;
+            lines.push_back(line);
+        }
+    }
+    lines.push_back(key + "\t" + profile_to_string(profile));
+
+    std::ofstream f(path, std::ios::trunc);
+    if (!f.is_open())
+        return false;
+
+    for (size_t i = 0; i < lines.size(); i++)
+        f << lines[i] << "\n";
+
+    return f.good();
+}
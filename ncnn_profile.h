@@ -0,0 +1,43 @@
+// ncnn_profile.h
+// Per-machine ncnn option profiles.
+// yolov8tune benchmarks option combinations and stores the fastest one in a
+// small text file, one line per "<cpu model>|<cores>|<model>" key, with
+// "|x<nets>" appended when it was tuned for several nets inferring at once.
+// YoloV8::load() looks up the current machine's line at startup.
+
+#ifndef NCNN_PROFILE_H
+#define NCNN_PROFILE_H
+
+#include <net.h>
+#include <string>
+
+#define NCNN_PROFILE_PATH "./yolov8.profile"
+
+struct NcnnProfile
+{
+    int num_threads;
+    int openmp_blocktime;
+    bool lightmode;
+    bool use_winograd_convolution;
+    bool use_sgemm_convolution;
+    bool use_fp16_packed;
+    bool use_fp16_storage;
+    bool use_fp16_arithmetic;
+    bool use_packing_layout;
+    float infer_ms; // measured when the profile was tuned
+};
+
+// CPU model string from /proc/cpuinfo, the ncnn core count and, above one,
+// the number of nets sharing the cores
+std::string machine_key(const std::string& model, int nets = 1);
+
+void profile_from_option(const ncnn::Option& opt, NcnnProfile& profile);
+void apply_profile(const NcnnProfile& profile, ncnn::Option& opt);
+std::string profile_to_string(const NcnnProfile& profile);
+
+// return true when a line for key exists and parses
+bool load_profile(const char* path, const std::string& key, NcnnProfile& profile);
+// replaces the line for key, other machines' lines are kept
+bool save_profile(const char* path, const std::string& key, const NcnnProfile& profile);
+
+#endif // NCNN_PROFILE_H
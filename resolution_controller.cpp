@@ -0,0 +1,155 @@
+// resolution_controller.cpp
+
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <iomanip>
+
+static const float ema_alpha = 0.2f;
+static const int down_after = 3;     // frames over budget before stepping down
+static const int up_after = 30;      // frames with headroom before stepping up
+static const int up_after_max = 16 * up_after; // after repeated overloads
+static const int min_samples = 10;  // frames at a size before its own average is trusted
+static const float up_margin = 0.8f; // next size must be predicted under 80% of budget
+
+std::vector<int> candidate_sizes(const std::vector<int>& sizes, int max_size)
+{
+    std::vector<int> out;
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        if (sizes[i] > 0 && sizes[i] < max_size)
+            out.push_back(sizes[i]);
+    }
+    out.push_back(max_size);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+ResolutionController::ResolutionController(const std::vector<int>& _sizes, int max_size, float _budget_ms)
+    : budget_ms(_budget_ms), index(0), cap_index(0), ema_ms(0.f), over_frames(0), under_frames(0),
+      up_frames(up_after), held_frames(-1)
+{
+    sizes = candidate_sizes(_sizes, max_size);
+
+    // start at the largest size, the controller only steps down when it has to
+    index = sizes.size() - 1;
+    cap_index = index;
+
+    size_ema.assign(sizes.size(), 0.f);
+    size_samples.assign(sizes.size(), 0);
+    frames.assign(sizes.size(), 0);
+    sum_ms.assign(sizes.size(), 0.0);
+}
+
+float ResolutionController::predicted_ms(int idx) const
+{
+    // prefer what we have recently measured at that size, otherwise scale by pixel count
+    if (size_samples[idx] >= min_samples)
+        return size_ema[idx];
+
+    float r = (float)sizes[idx] / sizes[index];
+    return ema_ms * r * r;
+}
+
+int ResolutionController::update(float latency_ms)
+{
+    frames[index]++;
+    sum_ms[index] += latency_ms;
+
+    if (!enabled())
+        return size();
+
+    ema_ms = (ema_ms == 0.f) ? latency_ms : ema_ms + ema_alpha * (latency_ms - ema_ms);
+    float& cost = size_ema[index];
+    cost = (size_samples[index]++ == 0) ? latency_ms : cost + ema_alpha * (latency_ms - cost);
+
+    // a step up that held without overload was worth it, drop the back-off
+    if (held_frames >= 0 && ++held_frames >= up_frames)
+    {
+        up_frames = up_after;
+        held_frames = -1;
+    }
+
+    over_frames = (ema_ms > budget_ms) ? over_frames + 1 : 0;
+
+    if (index + 1 <= cap_index && predicted_ms(index + 1) < budget_ms * up_margin)
+        under_frames++;
+    else
+        under_frames = 0;
+
+    int next = index;
+    if (over_frames >= down_after && index > 0)
+        next = index - 1;
+    else if (under_frames >= up_frames)
+        next = index + 1;
+
+    if (next < index)
+    {
+        // the cost measured here is stale once the load changes (throttling,
+        // other camera): forget it, so stepping back up is judged on the
+        // smaller size's fresh cost, and ask for a longer margin first
+        size_samples[index] = 0;
+        up_frames = std::min(up_frames * 2, up_after_max);
+    }
+    if (next != index)
+    {
+        // carry the estimate over so the new size is judged on its own cost
+        ema_ms = predicted_ms(next);
+        held_frames = (next > index) ? 0 : -1;
+        index = next;
+        over_frames = 0;
+        under_frames = 0;
+    }
+
+    return size();
+}
+
+void ResolutionController::set_size_cap(int cap)
+{
+    int c = sizes.size() - 1;
+    while (cap > 0 && c > 0 && sizes[c] > cap)
+        c--;
+    if (c == cap_index)
+        return;
+
+    // without a latency budget the size is pinned to the cap; with one, a
+    // raised cap is approached through the normal step-up
+    if (c < index || !enabled())
+    {
+        if (ema_ms > 0.f)
+            ema_ms = predicted_ms(c);
+        index = c;
+        over_frames = 0;
+        under_frames = 0;
+        held_frames = -1;
+    }
+    cap_index = c;
+}
+
+void ResolutionController::report(std::ostream& os, const std::string& tag) const
+{
+    long long total = 0;
+    for (size_t i = 0; i < frames.size(); i++)
+        total += frames[i];
+
+    os << "[RES " << tag << "] budget: ";
+    if (enabled())
+        os << std::fixed << std::setprecision(1) << budget_ms << " ms";
+    else
+        os << "off";
+    os << " | frames: " << total << "\n";
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        if (frames[i] == 0)
+            continue;
+
+        double avg = sum_ms[i] / frames[i];
+        os << "[RES " << tag << "]   size " << std::setw(4) << sizes[i]
+           << "  share " << std::fixed << std::setprecision(1) << std::setw(5) << 100.0 * frames[i] / total << "%"
+           << "  infer_ms " << std::setw(6) << avg
+           << "  fps " << std::setw(5) << (avg > 0.0 ? 1000.0 / avg : 0.0) << "\n";
+    }
+}
@@ -0,0 +1,66 @@
+// resolution_controller.h
+// Picks the YoloV8 input size per frame from the measured detect() latency.
+// Steps down quickly when the latency budget is exceeded and steps back up
+// only after a sustained margin, so the size does not oscillate. Each size's
+// cost is a decayed average of its recent frames; an overload forgets the
+// cost of the size it left and doubles the margin needed to return, so a
+// board that starts throttling settles on the smaller size.
+
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// the input sizes a controller capped at max_size steps through: the
+// positive candidates below max_size and max_size itself, ascending, no
+// duplicates; also the size list the thermal governor backs off along
+std::vector<int> candidate_sizes(const std::vector<int>& sizes, int max_size);
+
+class ResolutionController
+{
+public:
+    // sizes: candidate input sizes (multiples of 32), any order
+    // max_size: the process' configured target_size, see candidate_sizes()
+    // budget_ms <= 0 disables the controller and pins max_size
+    ResolutionController(const std::vector<int>& sizes, int max_size, float budget_ms);
+
+    bool enabled() const { return budget_ms > 0.f; }
+    int size() const { return sizes[index]; }
+    const std::vector<int>& all_sizes() const { return sizes; }
+
+    // feed the latency of the frame that just ran at size()
+    // returns the size to use for the next frame
+    int update(float latency_ms);
+
+    // upper bound from outside (thermal governor), 0 lifts it; the controller
+    // keeps working below the cap
+    void set_size_cap(int cap);
+
+    // per-size frame share, mean latency and FPS since start
+    void report(std::ostream& os, const std::string& tag) const;
+
+private:
+    float predicted_ms(int idx) const;
+
+    std::vector<int> sizes;
+    float budget_ms;
+    int index;
+    int cap_index;
+    float ema_ms;
+    int over_frames;
+    int under_frames;
+    int up_frames;    // under_frames needed to step up, grows after an overload
+    int held_frames;  // frames at the current size since a step up, -1 after other changes
+
+    // recent cost per size, what predicted_ms() uses
+    std::vector<float> size_ema;
+    std::vector<int> size_samples;
+
+    // since start, for report()
+    std::vector<long long> frames;
+    std::vector<double> sum_ms;
+};
+
+#endif // RESOLUTION_CONTROLLER_H
@@ -0,0 +1,101 @@
+// roi_mask.cpp
+
+#include "roi_mask.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+RoiMask::RoiMask()
+{
+}
+
+bool RoiMask::load(const std::string& path, int frame_w, int frame_h)
+{
+    polygons.clear();
+    bounding = cv::Rect();
+    mask_img.release();
+
+    std::ifstream f(path);
+    if (!f.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(f, line))
+    {
+        std::istringstream ss(line);
+        std::string kind;
+        if (!(ss >> kind) || kind[0] == '#')
+            continue;
+
+        std::vector<cv::Point> poly;
+        if (kind == "rect")
+        {
+            int x, y, w, h;
+            if (!(ss >> x >> y >> w >> h) || w <= 0 || h <= 0)
+                continue;
+            poly = {cv::Point(x, y), cv::Point(x + w, y), cv::Point(x + w, y + h), cv::Point(x, y + h)};
+        }
+        else if (kind == "poly")
+        {
+            std::string pt;
+            int x, y;
+            while (ss >> pt)
+            {
+                if (sscanf(pt.c_str(), "%d,%d", &x, &y) == 2)
+                    poly.push_back(cv::Point(x, y));
+            }
+            if (poly.size() < 3)
+                continue;
+        }
+        else
+            continue;
+
+        polygons.push_back(poly);
+    }
+
+    if (polygons.empty())
+        return false;
+
+    mask_img = cv::Mat::zeros(frame_h, frame_w, CV_8UC1);
+    cv::fillPoly(mask_img, polygons, cv::Scalar(255));
+
+    for (size_t i = 0; i < polygons.size(); i++)
+    {
+        cv::Rect r = cv::boundingRect(polygons[i]);
+        bounding = (i == 0) ? r : (bounding | r);
+    }
+    bounding &= cv::Rect(0, 0, frame_w, frame_h);
+
+    if (bounding.empty())
+    {
+        mask_img.release();
+        return false;
+    }
+    return true;
+}
+
+float RoiMask::crop_fraction() const
+{
+    if (empty())
+        return 1.f;
+    return (float)bounding.area() / (mask_img.cols * mask_img.rows);
+}
+
+void RoiMask::filter(std::vector<Object>& objects) const
+{
+    if (empty())
+        return;
+
+    size_t n = 0;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const cv::Rect_<float>& r = objects[i].rect;
+        int cx = std::min(std::max((int)(r.x + r.width * 0.5f), 0), mask_img.cols - 1);
+        int cy = std::min(std::max((int)(r.y + r.height * 0.5f), 0), mask_img.rows - 1);
+        if (mask_img.at<unsigned char>(cy, cx))
+            objects[n++] = objects[i];
+    }
+    objects.resize(n);
+}
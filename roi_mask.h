@@ -0,0 +1,41 @@
+// roi_mask.h
+// Static per-camera regions of interest.
+// A region file holds one region per line, in frame pixel coordinates:
+//   rect x y w h
+//   poly x1,y1 x2,y2 x3,y3 ...
+// Lines starting with # are ignored. Without a file the whole frame is used.
+
+#ifndef ROI_MASK_H
+#define ROI_MASK_H
+
+#include "yoloV8.h"
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+
+class RoiMask
+{
+public:
+    RoiMask();
+
+    // false when the file is missing or has no valid region (mask stays empty)
+    bool load(const std::string& path, int frame_w, int frame_h);
+
+    bool empty() const { return mask_img.empty(); }
+    // bounding crop of all regions, clipped to the frame
+    const cv::Rect& bounds() const { return bounding; }
+    // 8-bit, 255 inside a region
+    const cv::Mat& mask() const { return mask_img; }
+    // share of frame pixels inside bounds()
+    float crop_fraction() const;
+
+    // keeps only detections whose box centre falls inside a region
+    void filter(std::vector<Object>& objects) const;
+
+private:
+    std::vector<std::vector<cv::Point>> polygons;
+    cv::Rect bounding;
+    cv::Mat mask_img;
+};
+
+#endif // ROI_MASK_H
@@ -0,0 +1,176 @@
+// thermal_governor.cpp
+
+#include "thermal_governor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+static const double poll_s = 1.0;
+static const double down_wait_s = 10.0; // after a step, before the next step down
+static const double up_hold_s = 60.0;   // continuously cool before a step up
+static const float hysteresis_c = 5.f;
+static const float throttled_freq = 0.9f; // cur below 90% of max counts as throttled
+
+// Pi firmware flags: arm frequency capped, currently throttled, soft temperature limit
+static const unsigned throttled_now_mask = 0x2 | 0x4 | 0x8;
+
+static bool read_long(const std::string& path, long& value, int base = 10)
+{
+    std::ifstream f(path);
+    std::string text;
+    if (!(f >> text))
+        return false;
+
+    char* end = nullptr;
+    value = strtol(text.c_str(), &end, base);
+    return end != text.c_str();
+}
+
+bool SysfsThermal::read(ThermalSample& s) const
+{
+    long v = 0;
+    if (!read_long(root + "/class/thermal/thermal_zone0/temp", v))
+        return false;
+    s.temp_c = v / 1000.f;
+
+    s.cur_khz = read_long(root + "/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", v) ? (int)v : 0;
+    s.max_khz = read_long(root + "/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", v) ? (int)v : 0;
+    s.throttled = read_long(root + "/devices/platform/soc/soc:firmware/get_throttled", v, 16) ? (unsigned)v : 0;
+
+    return true;
+}
+
+ThermalGovernor::ThermalGovernor(const std::string& sysfs_root, float temp_limit_c, int num_threads,
+                                 const std::vector<int>& _sizes, float _camera_fps)
+    : sysfs(sysfs_root), limit_c(temp_limit_c), camera_fps(_camera_fps), current(0), previous(0),
+      sample(), have_sample(false), cooling(false), transitions(0)
+{
+    std::vector<int> sizes = _sizes;
+    std::sort(sizes.begin(), sizes.end(), std::greater<int>());
+    if (sizes.empty())
+        sizes.push_back(640);
+
+    // threads first (the smallest cost per watt saved), then input size, then frame rate
+    int threads = std::max(1, num_threads);
+    int fewer = std::max(1, threads - 1);
+    int half = std::max(1, threads / 2);
+    levels.push_back({threads, sizes[0], camera_fps});
+    levels.push_back({fewer, sizes[0], camera_fps});
+    for (size_t i = 1; i < sizes.size(); i++)
+        levels.push_back({fewer, sizes[i], camera_fps});
+    levels.push_back({half, sizes.back(), camera_fps});
+    levels.push_back({half, sizes.back(), camera_fps / 2});
+    levels.push_back({half, sizes.back(), camera_fps / 3});
+
+    levels.erase(std::unique(levels.begin(), levels.end(), [](const GovernorLevel& a, const GovernorLevel& b) {
+        return a.num_threads == b.num_threads && a.max_size == b.max_size && a.max_fps == b.max_fps;
+    }), levels.end());
+
+    level_seconds.assign(levels.size(), 0.0);
+    // a board that is already hot at start is backed off on the first poll
+    last_poll = cool_since = clock::now();
+    last_change = last_poll - std::chrono::seconds((int)up_hold_s);
+}
+
+bool ThermalGovernor::update()
+{
+    if (!enabled())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    clock::time_point now = clock::now();
+    double since_poll = std::chrono::duration<double>(now - last_poll).count();
+    if (have_sample && since_poll < poll_s)
+        return false;
+
+    int index = current.load();
+    level_seconds[index] += since_poll;
+    last_poll = now;
+
+    if (!sysfs.read(sample))
+        return false;
+    have_sample = true;
+
+    bool freq_capped = sample.max_khz > 0 && sample.cur_khz > 0 && sample.cur_khz < sample.max_khz * throttled_freq;
+    bool throttled = (sample.throttled & throttled_now_mask) != 0;
+
+    // a capped frequency at low temperature is just the cpufreq governor idling
+    bool hot = sample.temp_c >= limit_c || throttled || (freq_capped && sample.temp_c >= limit_c - hysteresis_c);
+    bool cool = sample.temp_c < limit_c - hysteresis_c && !throttled;
+
+    if (!cool)
+        cooling = false;
+    else if (!cooling)
+    {
+        cooling = true;
+        cool_since = now;
+    }
+
+    double since_change = std::chrono::duration<double>(now - last_change).count();
+    int next = index;
+    if (hot && index + 1 < (int)levels.size() && since_change >= down_wait_s)
+        next = index + 1;
+    else if (cooling && index > 0 && std::chrono::duration<double>(now - cool_since).count() >= up_hold_s
+             && since_change >= up_hold_s)
+        next = index - 1;
+
+    if (next == index)
+        return false;
+
+    previous = index;
+    current.store(next);
+    last_change = now;
+    cool_since = now;
+    transitions++;
+    return true;
+}
+
+int ThermalGovernor::frame_interval_ms() const
+{
+    const GovernorLevel& l = level();
+    if (l.max_fps <= 0.f || l.max_fps >= camera_fps)
+        return 0;
+    return (int)(1000.f / l.max_fps);
+}
+
+void ThermalGovernor::log_transition(std::ostream& os, const std::string& tag) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = current.load();
+    const GovernorLevel& l = levels[index];
+    char flags[16];
+    snprintf(flags, sizeof(flags), "0x%x", sample.throttled);
+
+    os << "[GOV " << tag << "] " << std::fixed << std::setprecision(1) << sample.temp_c << "C "
+       << sample.cur_khz / 1000 << "/" << sample.max_khz / 1000 << " MHz throttled " << flags << ": level "
+       << previous << " -> " << index << " (" << (index > previous ? "back off" : "restore")
+       << "), threads " << l.num_threads << ", size " << l.max_size << ", fps " << std::setprecision(0) << l.max_fps << "\n";
+}
+
+void ThermalGovernor::report(std::ostream& os, const std::string& tag) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    double total = 0.0;
+    for (double s : level_seconds)
+        total += s;
+
+    os << "[GOV " << tag << "] limit: ";
+    if (enabled())
+        os << std::fixed << std::setprecision(1) << limit_c << "C";
+    else
+        os << "off";
+    os << " | transitions: " << transitions << " | last " << std::setprecision(1) << sample.temp_c << "C\n";
+
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        if (level_seconds[i] <= 0.0)
+            continue;
+
+        os << "[GOV " << tag << "]   level " << i << "  threads " << levels[i].num_threads
+           << "  size " << std::setw(4) << levels[i].max_size << "  fps " << std::setw(3) << std::setprecision(0) << levels[i].max_fps
+           << "  time " << std::setprecision(1) << std::setw(5) << 100.0 * level_seconds[i] / total << "%\n";
+    }
+}
@@ -0,0 +1,107 @@
+// thermal_governor.h
+// Backs off inference load before the SoC reaches its throttle point and
+// restores it once the board has cooled down.
+//
+// Reads the CPU temperature, the current and maximum CPU frequency and, on a
+// Raspberry Pi, the firmware throttle flags from sysfs. The root is
+// configurable so a fake tree (plain text files) can stand in for /sys:
+//   <root>/class/thermal/thermal_zone0/temp                    millidegrees C
+//   <root>/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq    kHz
+//   <root>/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq    kHz
+//   <root>/devices/platform/soc/soc:firmware/get_throttled     hex, optional
+//
+// Levels go from full load to fewer ncnn threads, smaller input sizes and
+// finally a lower frame rate. The governor steps one level down while the
+// temperature is at the limit or the CPU is already throttled, waiting a
+// while after each step for the temperature to react, and one level up after
+// staying well below the limit for a minute.
+//
+// One governor serves the whole process: every inference thread calls
+// update() and applies level() when level_index() changes, so all threads
+// step together, once per transition.
+
+#ifndef THERMAL_GOVERNOR_H
+#define THERMAL_GOVERNOR_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct ThermalSample
+{
+    float temp_c;
+    int cur_khz;
+    int max_khz;
+    unsigned throttled; // Pi get_throttled bits, 0 where not available
+};
+
+class SysfsThermal
+{
+public:
+    explicit SysfsThermal(const std::string& root = "/sys") : root(root) {}
+
+    // false when the temperature cannot be read
+    bool read(ThermalSample& s) const;
+
+private:
+    std::string root;
+};
+
+struct GovernorLevel
+{
+    int num_threads;
+    int max_size;  // input size cap
+    float max_fps; // frame rate cap, the camera rate means none
+};
+
+class ThermalGovernor
+{
+public:
+    // sizes as candidate_sizes() returns them; temp_limit_c <= 0 disables it
+    ThermalGovernor(const std::string& sysfs_root, float temp_limit_c, int num_threads,
+                    const std::vector<int>& sizes, float camera_fps);
+
+    bool enabled() const { return limit_c > 0.f; }
+    const GovernorLevel& level() const { return levels[current.load()]; }
+    int level_index() const { return current.load(); }
+
+    // call once per frame from any thread, reads sysfs about once a second;
+    // true for the one caller whose update changed the level
+    bool update();
+
+    // pause between frames for the level's frame rate cap, 0 when uncapped
+    int frame_interval_ms() const;
+
+    // one line for the transition update() just made
+    void log_transition(std::ostream& os, const std::string& tag) const;
+    // time spent per level and the number of transitions since start
+    void report(std::ostream& os, const std::string& tag) const;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    SysfsThermal sysfs;
+    float limit_c;
+    float camera_fps;
+    std::vector<GovernorLevel> levels;
+    std::atomic<int> current;
+    int previous;
+
+    // guards everything below and previous, levels is fixed after construction
+    mutable std::mutex mutex;
+
+    ThermalSample sample;
+    bool have_sample;
+    clock::time_point last_poll;
+    clock::time_point last_change;
+    clock::time_point cool_since;
+    bool cooling;
+
+    std::vector<double> level_seconds;
+    int transitions;
+};
+
+#endif // THERMAL_GOVERNOR_H
@@ -15,9 +15,30 @@
 //modified 1-14-2023 Q-engineering
 
 #include "yoloV8.h"
+#include "ncnn_profile.h"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Compiled-in model: convert with ncnn's tool, then build with the model name
+//   ncnn2mem yolov8n.param yolov8n.bin yolov8n.id.h yolov8n.mem.h
+//   g++ -DYOLOV8_EMBEDDED_MODEL=yolov8n ...
+// load(..., "yolov8n") then uses yolov8n_param_bin / yolov8n_bin from yolov8n.mem.h
+#ifdef YOLOV8_EMBEDDED_MODEL
+#define YOLOV8_STR_(x) #x
+#define YOLOV8_STR(x) YOLOV8_STR_(x)
+#define YOLOV8_CAT_(a, b) a##b
+#define YOLOV8_CAT(a, b) YOLOV8_CAT_(a, b)
+#include YOLOV8_STR(YOLOV8_EMBEDDED_MODEL.mem.h)
+#endif
 
 const char* class_names[] = {
     "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
@@ -149,11 +170,12 @@ static void generate_grids_and_stride(const int target_w, const int target_h, st
         }
     }
 }
-static void generate_proposals(std::vector<GridAndStride> grid_strides, const ncnn::Mat& pred, float prob_threshold, std::vector<Object>& objects)
+static void generate_proposals(const std::vector<GridAndStride>& grid_strides, const ncnn::Mat& pred, float prob_threshold, std::vector<Object>& objects)
 {
     const int num_points = grid_strides.size();
-    const int num_class = 80;
     const int reg_max_1 = 16;
+    // 80 for the stock model, fewer for a head pruned with yolov8prune
+    const int num_class = pred.w - 4 * reg_max_1;
 
     for (int i = 0; i < num_points; i++)
     {
@@ -230,21 +252,263 @@ static void generate_proposals(std::vector<GridAndStride> grid_strides, const nc
     }
 }
 
-YoloV8::YoloV8()
+// whole file mapped read-only, nullptr if missing
+static void* map_file(const std::string& path, size_t& bytes)
 {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    void* p = nullptr;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        bytes = st.st_size;
+        p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+            p = nullptr;
+        else
+            madvise(p, bytes, MADV_WILLNEED);
+    }
+    close(fd);
+    return p;
+}
+
+// ms since t, and moves t to now
+static float lap_ms(std::chrono::steady_clock::time_point& t)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration<float, std::milli>(now - t).count();
+    t = now;
+    return ms;
+}
+
+static void make_tiles(int width, int height, int tile_size, float overlap, std::vector<cv::Rect>& tiles)
+{
+    tiles.clear();
+
+    int tw = std::min(tile_size, width);
+    int th = std::min(tile_size, height);
+    int step = std::max(1, (int)(tile_size * (1.f - overlap)));
+    int nx = (width <= tw) ? 1 : (width - tw + step - 1) / step + 1;
+    int ny = (height <= th) ? 1 : (height - th + step - 1) / step + 1;
+
+    // spread the tiles evenly so the last one ends on the frame edge
+    for (int j = 0; j < ny; j++)
+    {
+        int y = (ny == 1) ? 0 : (height - th) * j / (ny - 1);
+        for (int i = 0; i < nx; i++)
+        {
+            int x = (nx == 1) ? 0 : (width - tw) * i / (nx - 1);
+            tiles.push_back(cv::Rect(x, y, tw, th));
+        }
+    }
+}
+
+static void merge_tile_objects(std::vector<TileObject>& candidates, std::vector<Object>& objects, float nms_threshold)
+{
+    // boxes cut by a seam overlap most of their counterpart from the
+    // neighbouring tile without reaching the nms iou, so match those on
+    // intersection over the smaller box and grow the kept box instead
+    const float seam_threshold = 0.6f;
+
+    struct
+    {
+        bool operator()(const TileObject& a, const TileObject& b) const
+        {
+            return a.obj.prob > b.obj.prob;
+        }
+    } prob_greater;
+    std::sort(candidates.begin(), candidates.end(), prob_greater);
+
+    std::vector<TileObject> kept;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        const TileObject& a = candidates[i];
+
+        bool keep = true;
+        for (size_t j = 0; j < kept.size(); j++)
+        {
+            TileObject& b = kept[j];
+
+            float inter_area = (a.obj.rect & b.obj.rect).area();
+            float union_area = a.obj.rect.area() + b.obj.rect.area() - inter_area;
+            if (inter_area / union_area > nms_threshold)
+            {
+                keep = false;
+                break;
+            }
+
+            float min_area = std::min(a.obj.rect.area(), b.obj.rect.area());
+            if (a.tile != b.tile && (a.cut || b.cut) && min_area > 0.f && inter_area / min_area > seam_threshold)
+            {
+                b.obj.rect = b.obj.rect | a.obj.rect;
+                b.cut = a.cut && b.cut;
+                keep = false;
+                break;
+            }
+        }
+
+        if (keep)
+            kept.push_back(a);
+    }
+
+    objects.resize(kept.size());
+    for (size_t i = 0; i < kept.size(); i++)
+        objects[i] = kept[i].obj;
+}
+
+YoloV8::YoloV8() : input_blob(0), output_blob(0), param_map(nullptr), param_map_bytes(0), bin_map(nullptr), bin_map_bytes(0),
+    source(""), load_time_ms(0.f), tiles_run(0), timings(), output_w(0), output_bytes(0)
+{
+}
+
+YoloV8::~YoloV8()
+{
+    yolo.clear();
+    unmap_model();
+}
+
+void YoloV8::unmap_model()
+{
+    if (param_map)
+        munmap(param_map, param_map_bytes);
+    if (bin_map)
+        munmap(bin_map, bin_map_bytes);
+    param_map = nullptr;
+    bin_map = nullptr;
 }
 
 
-int YoloV8::load(int _target_size)
+ncnn::Option YoloV8::default_option(const char* model, int nets, bool verbose)
 {
+    ncnn::Option opt;
+    opt.num_threads = 4;
+
+    NcnnProfile profile;
+    if (load_profile(NCNN_PROFILE_PATH, machine_key(model, nets), profile))
+    {
+        apply_profile(profile, opt);
+        if (verbose)
+            fprintf(stderr, "ncnn profile: %s\n", profile_to_string(profile).c_str());
+    }
+    else if (nets > 1 && load_profile(NCNN_PROFILE_PATH, machine_key(model), profile))
+    {
+        // tuned for one net owning every core, split the threads between the nets
+        profile.num_threads = std::max(1, profile.num_threads / nets);
+        apply_profile(profile, opt);
+        if (verbose)
+            fprintf(stderr, "ncnn profile (1 of %d nets): %s\n", nets, profile_to_string(profile).c_str());
+    }
+
+    return opt;
+}
+
+int YoloV8::load(int _target_size, const char* model, int nets)
+{
+    return load(_target_size, default_option(model, nets, true), model);
+}
+
+int YoloV8::load(int _target_size, const ncnn::Option& opt, const char* model)
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
     yolo.clear();
+    unmap_model();
+    grid_cache.clear();
 
-    yolo.opt = ncnn::Option();
+    yolo.opt = opt;
+    source = "";
 
-    yolo.opt.num_threads = 4;
+    std::string path = std::string("./") + model;
 
-    yolo.load_param("./yolov8n.param");
-    yolo.load_model("./yolov8n.bin");
+#ifdef YOLOV8_EMBEDDED_MODEL
+    if (strcmp(model, YOLOV8_STR(YOLOV8_EMBEDDED_MODEL)) == 0)
+    {
+        const unsigned char* param_mem = YOLOV8_CAT(YOLOV8_EMBEDDED_MODEL, _param_bin);
+        const unsigned char* bin_mem = YOLOV8_CAT(YOLOV8_EMBEDDED_MODEL, _bin);
+        if (yolo.load_param(param_mem) == (int)sizeof(YOLOV8_CAT(YOLOV8_EMBEDDED_MODEL, _param_bin))
+                && yolo.load_model(bin_mem) == (int)sizeof(YOLOV8_CAT(YOLOV8_EMBEDDED_MODEL, _bin)))
+        {
+            source = "embedded";
+        }
+        else
+        {
+            // built against another ncnn version, try the files next to the binary
+            fprintf(stderr, "embedded %s does not load, trying files\n", model);
+            yolo.clear();
+        }
+    }
+#endif
+
+    // binary param needs no parsing and the weights are used straight from the
+    // page cache, so a restart costs no copy; the mapping lives as long as the net
+    if (!*source && (param_map = map_file(path + ".param.bin", param_map_bytes)) != nullptr)
+    {
+        bin_map = map_file(path + ".bin", bin_map_bytes);
+        if (bin_map && yolo.load_param((const unsigned char*)param_map) == (int)param_map_bytes
+                && yolo.load_model((const unsigned char*)bin_map) == (int)bin_map_bytes)
+        {
+            source = "mmap";
+        }
+        else
+        {
+            fprintf(stderr, "%s.param.bin does not match %s.bin, trying %s.param\n", path.c_str(), path.c_str(), path.c_str());
+            yolo.clear();
+            unmap_model();
+        }
+    }
+
+    if (!*source)
+    {
+        if (yolo.load_param((path + ".param").c_str()) != 0 || yolo.load_model((path + ".bin").c_str()) != 0)
+        {
+            yolo.clear();
+            return -1;
+        }
+        source = "file";
+    }
+
+    if (yolo.input_indexes().empty() || yolo.output_indexes().empty())
+        return -1;
+    input_blob = yolo.input_indexes()[0];
+    output_blob = yolo.output_indexes()[0];
+
+    // pruned head: row i of the output is COCO class class_ids[i]
+    class_ids.clear();
+    std::ifstream classes(path + ".classes");
+    if (classes.is_open())
+    {
+        std::vector<bool> seen(80, false);
+        bool valid = true;
+        int id;
+        while (classes >> id)
+        {
+            valid = valid && id >= 0 && id < 80 && !seen[id];
+            if (valid)
+                seen[id] = true;
+            class_ids.push_back(id);
+        }
+        valid = valid && classes.eof() && !class_ids.empty();
+
+        // the rows must match the file, a stale .classes next to a re-exported
+        // model would map labels out of range; a 32x32 frame is enough to see
+        if (valid)
+        {
+            ncnn::Mat probe(32, 32, 3);
+            probe.fill(0.f);
+            ncnn::Extractor ex = yolo.create_extractor();
+            ex.input(input_blob, probe);
+            ncnn::Mat out;
+            valid = ex.extract(output_blob, out) == 0 && out.w == 64 + (int)class_ids.size();
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "%s.classes does not match the model output, using COCO labels\n", path.c_str());
+            class_ids.clear();
+        }
+    }
 
     target_size = _target_size;
     mean_vals[0] = 103.53f;
@@ -254,11 +518,32 @@ int YoloV8::load(int _target_size)
     norm_vals[1] = 1.0 / 255.0f;
     norm_vals[2] = 1.0 / 255.0f;
 
+    load_time_ms = lap_ms(t0);
+    fprintf(stderr, "model %s: %s, %.1f ms\n", model, source, load_time_ms);
+
     return 0;
 }
 
-int YoloV8::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+int YoloV8::warmup(int width, int height, int runs)
 {
+    // mid-gray like the letterbox padding, nothing is detected
+    cv::Mat frame(height, width, CV_8UC3, cv::Scalar(114, 114, 114));
+    std::vector<Object> objects;
+    for (int i = 0; i < runs; i++)
+        detect(frame, objects);
+
+    return 0;
+}
+
+void YoloV8::set_target_size(int _target_size)
+{
+    target_size = _target_size;
+}
+
+int YoloV8::infer(const cv::Mat& rgb, std::vector<Object>& proposals, float prob_threshold)
+{
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+
     int width = rgb.cols;
     int height = rgb.rows;
 
@@ -279,7 +564,8 @@ int YoloV8::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_
         w = w * scale;
     }
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB2BGR, width, height, w, h);
+    // pass the row stride so roi views into a larger frame need no copy
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB2BGR, width, height, (int)rgb.step[0], w, h);
 
     // pad to target_size rectangle
     int wpad = (w + 31) / 32 * 32 - w;
@@ -288,40 +574,53 @@ int YoloV8::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_
     ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
 
     in_pad.substract_mean_normalize(0, norm_vals);
+    timings.preprocess_ms += lap_ms(t);
 
     ncnn::Extractor ex = yolo.create_extractor();
 
-    ex.input("images", in_pad);
-
-    std::vector<Object> proposals;
+    ex.input(input_blob, in_pad);
 
     ncnn::Mat out;
-    ex.extract("output", out);
+    ex.extract(output_blob, out);
+    timings.inference_ms += lap_ms(t);
+    output_w = out.w;
+    output_bytes = out.total() * out.elemsize;
+
+    std::vector<GridAndStride>& grid_strides = grid_cache[(in_pad.w << 16) | in_pad.h];
+    if (grid_strides.empty())
+    {
+        std::vector<int> strides = {8, 16, 32}; // might have stride=64
+        generate_grids_and_stride(in_pad.w, in_pad.h, strides, grid_strides);
+    }
 
-    std::vector<int> strides = {8, 16, 32}; // might have stride=64
-    std::vector<GridAndStride> grid_strides;
-    generate_grids_and_stride(in_pad.w, in_pad.h, strides, grid_strides);
+    size_t first = proposals.size();
     generate_proposals(grid_strides, out, prob_threshold, proposals);
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
+    for (size_t i = first; i < proposals.size(); i++)
+    {
+        // pruned head: row index -> original COCO label
+        if (!class_ids.empty())
+            proposals[i].label = class_ids[proposals[i].label];
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+        // adjust offset to original unpadded
+        proposals[i].rect.x = (proposals[i].rect.x - (wpad / 2)) / scale;
+        proposals[i].rect.y = (proposals[i].rect.y - (hpad / 2)) / scale;
+        proposals[i].rect.width /= scale;
+        proposals[i].rect.height /= scale;
+    }
+    timings.decode_ms += lap_ms(t);
 
-    int count = picked.size();
+    return 0;
+}
 
-    objects.resize(count);
-    for (int i = 0; i < count; i++)
+static void clip_and_sort_by_area(std::vector<Object>& objects, int width, int height)
+{
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        objects[i] = proposals[picked[i]];
-
-        // adjust offset to original unpadded
-        float x0 = (objects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (objects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (objects[i].rect.x + objects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (objects[i].rect.y + objects[i].rect.height - (hpad / 2)) / scale;
+        float x0 = objects[i].rect.x;
+        float y0 = objects[i].rect.y;
+        float x1 = objects[i].rect.x + objects[i].rect.width;
+        float y1 = objects[i].rect.y + objects[i].rect.height;
 
         // clip
         x0 = std::max(std::min(x0, (float)(width - 1)), 0.f);
@@ -344,6 +643,151 @@ int YoloV8::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_
         }
     } objects_area_greater;
     std::sort(objects.begin(), objects.end(), objects_area_greater);
+}
+
+int YoloV8::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    timings = DetectTimings();
+
+    std::vector<Object> proposals;
+    infer(rgb, proposals, prob_threshold);
+
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+
+    // sort all proposals by score from highest to lowest
+    qsort_descent_inplace(proposals);
+
+    // apply nms with nms_threshold
+    std::vector<int> picked;
+    nms_sorted_bboxes(proposals, picked, nms_threshold);
+
+    int count = picked.size();
+
+    objects.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        objects[i] = proposals[picked[i]];
+    }
+
+    clip_and_sort_by_area(objects, rgb.cols, rgb.rows);
+    timings.nms_ms += lap_ms(t);
+
+    return 0;
+}
+
+int YoloV8::region_target_size(int frame_w, int frame_h, const cv::Rect& roi) const
+{
+    float ratio = (float)std::max(roi.width, roi.height) / std::max(frame_w, frame_h);
+    int size = (int)(target_size * ratio + 31) / 32 * 32;
+    return std::max(32, std::min(size, target_size));
+}
+
+int YoloV8::detect(const cv::Mat& rgb, const cv::Rect& roi, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    cv::Rect r = roi & cv::Rect(0, 0, rgb.cols, rgb.rows);
+    if (r.empty() || r.area() == rgb.cols * rgb.rows)
+        return detect(rgb, objects, prob_threshold, nms_threshold);
+
+    int full_size = target_size;
+    target_size = region_target_size(rgb.cols, rgb.rows, r);
+
+    int ret = detect(rgb(r), objects, prob_threshold, nms_threshold);
+
+    target_size = full_size;
+
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        objects[i].rect.x += r.x;
+        objects[i].rect.y += r.y;
+    }
+
+    return ret;
+}
+
+int YoloV8::detect_tiled(const cv::Mat& rgb, std::vector<Object>& objects, int tile_size, float overlap,
+                         const cv::Mat& active_mask, float prob_threshold, float nms_threshold)
+{
+    // a tile skipped by the mask keeps its boxes, re-checked after this many frames
+    const int tile_refresh = 30;
+    // box edges this close to an inner tile edge count as cut by the seam
+    const float seam_px = 4.f;
+
+    int width = rgb.cols;
+    int height = rgb.rows;
+
+    std::vector<cv::Rect> tiles;
+    make_tiles(width, height, tile_size, overlap, tiles);
+    if (tiles != tile_rects)
+    {
+        tile_rects = tiles;
+        tile_cache.assign(tiles.size(), std::vector<TileObject>());
+        tile_age.assign(tiles.size(), 0);
+    }
+
+    float mask_sx = active_mask.empty() ? 1.f : (float)active_mask.cols / width;
+    float mask_sy = active_mask.empty() ? 1.f : (float)active_mask.rows / height;
+
+    tiles_run = 0;
+    timings = DetectTimings();
+    std::vector<TileObject> candidates;
+    for (int t = 0; t < (int)tiles.size(); t++)
+    {
+        const cv::Rect& r = tiles[t];
+
+        bool active = true;
+        if (!active_mask.empty())
+        {
+            cv::Rect mr((int)(r.x * mask_sx), (int)(r.y * mask_sy), std::max(1, (int)(r.width * mask_sx)), std::max(1, (int)(r.height * mask_sy)));
+            mr &= cv::Rect(0, 0, active_mask.cols, active_mask.rows);
+            active = !mr.empty() && cv::countNonZero(active_mask(mr)) > 0;
+        }
+
+        // an empty inactive tile stays empty, one with boxes is re-checked now and then
+        if (active || (!tile_cache[t].empty() && tile_age[t] >= tile_refresh))
+        {
+            std::vector<Object> proposals;
+            infer(rgb(r), proposals, prob_threshold);
+
+            std::chrono::steady_clock::time_point t_nms = std::chrono::steady_clock::now();
+            qsort_descent_inplace(proposals);
+            std::vector<int> picked;
+            nms_sorted_bboxes(proposals, picked, nms_threshold);
+
+            std::vector<TileObject>& cache = tile_cache[t];
+            cache.resize(picked.size());
+            for (size_t i = 0; i < picked.size(); i++)
+            {
+                Object& obj = cache[i].obj;
+                obj = proposals[picked[i]];
+
+                bool cut = (r.x > 0 && obj.rect.x < seam_px)
+                           || (r.y > 0 && obj.rect.y < seam_px)
+                           || (r.x + r.width < width && obj.rect.x + obj.rect.width > r.width - seam_px)
+                           || (r.y + r.height < height && obj.rect.y + obj.rect.height > r.height - seam_px);
+
+                obj.rect.x += r.x;
+                obj.rect.y += r.y;
+                cache[i].tile = t;
+                cache[i].cut = cut;
+            }
+            timings.nms_ms += lap_ms(t_nms);
+
+            tile_age[t] = 0;
+            tiles_run++;
+        }
+        else
+        {
+            tile_age[t]++;
+        }
+
+        candidates.insert(candidates.end(), tile_cache[t].begin(), tile_cache[t].end());
+    }
+
+    std::chrono::steady_clock::time_point t_merge = std::chrono::steady_clock::now();
+    merge_tile_objects(candidates, objects, nms_threshold);
+
+    clip_and_sort_by_area(objects, width, height);
+    timings.nms_ms += lap_ms(t_merge);
 
     return 0;
 }
@@ -360,7 +804,8 @@ int YoloV8::draw(cv::Mat& rgb, const std::vector<Object>& objects)
         cv::rectangle(rgb, obj.rect, cv::Scalar(255, 0, 0));
 
         char text[256];
-        sprintf(text, "%s %.1f%%", class_names[obj.label], obj.prob * 100);
+        const char* name = (obj.label >= 0 && obj.label < 80) ? class_names[obj.label] : "?";
+        sprintf(text, "%s %.1f%%", name, obj.prob * 100);
 
         int baseLine = 0;
         cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
@@ -19,6 +19,7 @@
 
 #include <opencv2/core/core.hpp>
 #include <net.h>
+#include <map>
 
 struct Object
 {
@@ -34,18 +35,99 @@ struct GridAndStride
     int stride;
 };
 
+struct TileObject
+{
+    Object obj;
+    int tile;
+    bool cut; // touches an inner tile edge, likely the part of a larger box
+};
+
+// wall time of the last detect()/detect_tiled() call by stage, summed over tiles
+struct DetectTimings
+{
+    float preprocess_ms; // resize, pad, normalize
+    float inference_ms;  // ncnn extract
+    float decode_ms;     // proposals from the output rows
+    float nms_ms;        // sort, nms, tile merge, clip
+};
+
 class YoloV8
 {
 public:
     YoloV8();
-    int load(int target_size);
+    ~YoloV8();
+    // model, fastest source first: compiled in (YOLOV8_EMBEDDED_MODEL), binary
+    // "./<model>.param.bin" + "./<model>.bin" mapped and loaded in place, or
+    // the text "./<model>.param" + "./<model>.bin". Options from the machine's
+    // line in NCNN_PROFILE_PATH when yolov8tune has written one; nets is how
+    // many nets infer at the same time in this process
+    int load(int target_size, const char* model = "yolov8n", int nets = 1);
+    int load(int target_size, const ncnn::Option& opt, const char* model = "yolov8n");
+    // the options load(target_size, model, nets) uses, e.g. for the thread count
+    static ncnn::Option default_option(const char* model, int nets = 1, bool verbose = false);
+    // "embedded", "mmap" or "file", and how long load() took
+    const char* model_source() const { return source; }
+    float load_ms() const { return load_time_ms; }
+    // detect() on a blank width x height frame, so the first real frame does not
+    // pay for workspace and allocator growth
+    int warmup(int width, int height, int runs = 1);
+    void set_target_size(int target_size);
+    int get_target_size() const { return target_size; }
+    // takes effect with the next detect(), no reload needed
+    void set_num_threads(int n) { yolo.opt.num_threads = n; }
+    int get_num_threads() const { return yolo.opt.num_threads; }
+    // classes in the output rows, 80 unless the model was pruned by yolov8prune
+    int num_classes() const { return class_ids.empty() ? 80 : (int)class_ids.size(); }
     int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
-    int draw(cv::Mat& rgb, const std::vector<Object>& objects);
+    // infer only on rgb(roi), at target_size scaled by the crop/frame ratio so
+    // objects keep their pixel scale; boxes come back in frame coordinates
+    int detect(const cv::Mat& rgb, const cv::Rect& roi, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+    int region_target_size(int frame_w, int frame_h, const cv::Rect& roi) const;
+    // for frames much larger than target_size: overlapping tile_size tiles run one
+    // after another through the same net at target_size, boxes are merged across
+    // seams. Tiles without a nonzero pixel in active_mask (motion/roi, any
+    // resolution) are skipped and keep their previous detections.
+    int detect_tiled(const cv::Mat& rgb, std::vector<Object>& objects, int tile_size, float overlap = 0.2f,
+                     const cv::Mat& active_mask = cv::Mat(), float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+    int last_tiles_run() const { return tiles_run; }
+    int last_tiles_total() const { return (int)tile_rects.size(); }
+    const DetectTimings& last_timings() const { return timings; }
+    // "output" blob of the last inference as extracted: w is 64 box bins + classes
+    int last_output_w() const { return output_w; }
+    size_t last_output_bytes() const { return output_bytes; }
+    static int draw(cv::Mat& rgb, const std::vector<Object>& objects);
 private:
+    // proposals in rgb pixel coordinates, appended unsorted and before nms
+    int infer(const cv::Mat& rgb, std::vector<Object>& proposals, float prob_threshold);
+
+    void unmap_model();
+
     ncnn::Net yolo;
+    // blob indexes, binary params carry no names
+    int input_blob;
+    int output_blob;
+    // mapped .param.bin/.bin, the net references the weights in place
+    void* param_map;
+    size_t param_map_bytes;
+    void* bin_map;
+    size_t bin_map_bytes;
+    const char* source;
+    float load_time_ms;
     int target_size;
     float mean_vals[3];
     float norm_vals[3];
+    // original COCO ids of a pruned head ("./<model>.classes"), empty for the full model
+    std::vector<int> class_ids;
+    // grid/stride tables per padded input shape, kept across size switches
+    std::map<int, std::vector<GridAndStride>> grid_cache;
+    // detect_tiled state: layout, last detections and frames since inferred per tile
+    std::vector<cv::Rect> tile_rects;
+    std::vector<std::vector<TileObject>> tile_cache;
+    std::vector<int> tile_age;
+    int tiles_run;
+    DetectTimings timings;
+    int output_w;
+    size_t output_bytes;
 };
 
 #endif // YOLOV8_H
@@ -1,14 +1,37 @@
 // yolov8_dualcam.cpp
 // Dual-camera real-time human-only detector with async logging.
 // Requires yolov8.cpp/yolov8.h (Qengineering / your working YoloV8 class).
-// Compile with: g++ yolov8.cpp yolov8_dualcam.cpp -o YoloV8Dual `pkg-config --cflags --libs opencv4` -I /home/pi/ncnn/build/install/include/ncnn -L /home/pi/ncnn/build/install/lib -lncnn -fopenmp -lpthread -O3 -std=c++17
+// Compile with: g++ yolov8.cpp ncnn_profile.cpp resolution_controller.cpp roi_mask.cpp motion_mask.cpp frame_bus.cpp http_util.cpp mjpeg_server.cpp metrics.cpp frame_trace.cpp thermal_governor.cpp yolov8_dualcam.cpp -o YoloV8Dual `pkg-config --cflags --libs opencv4` -lrt -I /home/pi/ncnn/build/install/include/ncnn -L /home/pi/ncnn/build/install/lib -lncnn -fopenmp -lpthread -O3 -std=c++17
+// Adaptive input size: YOLO_LATENCY_BUDGET_MS=<ms> [YOLO_SIZES=320,416,512,640] ./YoloV8Dual
+// Person-only head: ./YoloV8Prune yolov8n yolov8n_person 0 && YOLO_MODEL=yolov8n_person ./YoloV8Dual
+// Regions of interest: $YOLO_ROI_DIR/video0.roi (default ./video0.roi), see roi_mask.h
+// Shared capture: ./YoloV8Capture /dev/video0 & ./YoloV8Dual shm:/yolo_video0 shm:/yolo_video2
+// High resolution: YOLO_CAPTURE_W=1920 YOLO_CAPTURE_H=1080 YOLO_TILE_SIZE=640 [YOLO_MOTION=1] ./YoloV8Dual
+// Live preview: YOLO_PREVIEW_PORT=8080 ./YoloV8Dual, then http://<pi>:8080/ (camera 0) and :8081 (camera 1)
+// Prometheus metrics: YOLO_METRICS_PORT=9464 ./YoloV8Dual, then curl http://<pi>:9464/metrics
+// Frame tracing: YOLO_TRACE=trace.json [YOLO_TRACE_EVENTS=65536] ./YoloV8Dual, Ctrl-C writes the trace
+// Fast restart: ncnn2mem yolov8n.param yolov8n.bin yolov8n.id.h yolov8n.mem.h && mv yolov8n.param.bin .
+//   (mapped instead of parsed), or build with -DYOLOV8_EMBEDDED_MODEL=yolov8n; YOLO_WARMUP=<runs> (default 1)
+// Thermal governor: YOLO_TEMP_LIMIT=75 [YOLO_SYSFS_ROOT=/sys] ./YoloV8Dual, see thermal_governor.h
 
 #include "yoloV8.h"
+#include "resolution_controller.h"
+#include "roi_mask.h"
+#include "motion_mask.h"
+#include "frame_bus.h"
+#include "mjpeg_server.h"
+#include "metrics.h"
+#include "frame_trace.h"
+#include "thermal_governor.h"
+#include "env_config.h"
 #include <opencv2/opencv.hpp>
 #include <chrono>
+#include <csignal>
 #include <thread>
+#include <functional>
 #include <mutex>
 #include <deque>
+#include <future>
 #include <atomic>
 #include <filesystem>
 #include <fstream>
@@ -30,13 +53,20 @@ struct FrameResult {
     long long ts_ms;        // timestamp when detection finished (ms since epoch)
     double capture_ms;      // capture -> detect start (approx)
     double infer_ms;        // inference time (ms)
+    int input_size;         // detector input size used for this frame
     double total_ms;        // capture -> finished (ms)
     cv::Mat frame_for_save; // only small crops will be used by logger (move semantics)
+    double save_scale;      // frame_for_save size relative to the detection frame
+    high_resolution_clock::time_point t_queued; // pushed to results_q, for the logger's queue wait
+    uint64_t frame_id;      // trace id from capture, 0 when tracing is off
+    int64_t queued_ns;      // trace clock at push
 };
 
 std::mutex q_mutex;
 std::deque<FrameResult> results_q;
 std::atomic<bool> stop_all(false);
+// for the time to first detection after a (re)start
+const high_resolution_clock::time_point t_process_start = high_resolution_clock::now();
 
 // Make dir for detections
 void ensure_dirs() {
@@ -68,6 +98,7 @@ std::string make_json(const FrameResult &r) {
     j << "\"human_count\": " << r.human_count << ",";
     j << "\"capture_ms\": " << std::fixed << std::setprecision(2) << r.capture_ms << ",";
     j << "\"infer_ms\": " << std::fixed << std::setprecision(2) << r.infer_ms << ",";
+    j << "\"input_size\": " << r.input_size << ",";
     j << "\"total_ms\": " << std::fixed << std::setprecision(2) << r.total_ms << ",";
     j << "\"persons\": [";
     for (size_t i = 0; i < r.persons.size(); ++i) {
@@ -86,6 +117,8 @@ std::string make_json(const FrameResult &r) {
 // Logger thread: writes JSON and saves person crop images
 void logger_thread_func() {
     ensure_dirs();
+    ThreadMetrics* metrics = metrics_registry().add_thread("logger");
+    trace_thread_name("logger");
     while (!stop_all) {
         FrameResult item;
         bool has = false;
@@ -101,6 +134,11 @@ void logger_thread_func() {
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
+        auto t_write = high_resolution_clock::now();
+        metrics->record(STAGE_QUEUE_WAIT, duration_cast<microseconds>(t_write - item.t_queued).count() / 1000.0);
+        if (item.frame_id)
+            trace_async("results_q", item.frame_id, item.queued_ns, trace_now_ns());
+        TraceSpan trace_log("log_write", item.frame_id);
 
         // Only save when human detected > 0
         if (item.human_count > 0) {
@@ -118,7 +156,10 @@ void logger_thread_func() {
                 const auto &p = item.persons[i];
                 // Crop from frame_for_save (which may be full frame or smaller if memory)
                 if (!item.frame_for_save.empty()) {
-                    cv::Rect r = p.bbox & cv::Rect(0,0,item.frame_for_save.cols, item.frame_for_save.rows);
+                    // bbox is in detection frame coordinates, frame_for_save may be downscaled
+                    cv::Rect sb(p.bbox.x * item.save_scale, p.bbox.y * item.save_scale,
+                                p.bbox.width * item.save_scale, p.bbox.height * item.save_scale);
+                    cv::Rect r = sb & cv::Rect(0,0,item.frame_for_save.cols, item.frame_for_save.rows);
                     if (r.width > 4 && r.height > 4) {
                         cv::Mat crop = item.frame_for_save(r).clone();
                         std::ostringstream fname;
@@ -129,31 +170,93 @@ void logger_thread_func() {
                     }
                 }
             }
+            metrics->record(STAGE_LOG_WRITE, duration_cast<microseconds>(high_resolution_clock::now() - t_write).count() / 1000.0);
         }
         // else skip saving to disk to reduce IO
     }
 }
 
 // Detection thread for one camera
-void camera_thread_func(const std::string cam_dev, int thread_id, int target_size=640, float conf_thresh=0.35f) {
+void camera_thread_func(const std::string cam_dev, int thread_id, ThermalGovernor& governor, int target_size=640, float conf_thresh=0.35f) {
     try {
         // Each thread uses its own YoloV8 instance (avoids locking issues)
         YoloV8 yolo;
-        yolo.load(target_size);
+        std::string model = env_str("YOLO_MODEL", "yolov8n");
+        if (yolo.load(target_size, model.c_str(), 2) != 0) {  // two cameras share the cores
+            std::cerr << "[ERR] Cannot load model " << model << std::endl;
+            return;
+        }
         // configure internal net threads if exposed (not in all ports)
         // Example: yolo.net.opt.num_threads = 4; -> depends on implementation
 
-        cv::VideoCapture cap(cam_dev, cv::CAP_V4L2);
-        cap.set(cv::CAP_PROP_FRAME_WIDTH, 640);
-        cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
-        cap.set(cv::CAP_PROP_FPS, 30);
-
-        if (!cap.isOpened()) {
-            std::cerr << "[ERR] Cannot open camera " << cam_dev << std::endl;
-            return;
+        // warm-up inference while the camera opens; the future waits on any early return
+        int warmup_runs = env_int("YOLO_WARMUP", 1);
+        double warmup_ms = 0.0;
+        std::future<void> warmup = std::async(std::launch::async, [&] {
+            auto tw = high_resolution_clock::now();
+            yolo.warmup(env_int("YOLO_CAPTURE_W", 640), env_int("YOLO_CAPTURE_H", 480), warmup_runs);
+            warmup_ms = duration_cast<microseconds>(high_resolution_clock::now() - tw).count() / 1000.0;
+        });
+        bool first_detection = true;
+
+        // steps the input size down/up against the latency budget (off unless configured)
+        ResolutionController res_ctrl(env_int_list("YOLO_SIZES", {320, 416, 512, 640}), target_size,
+                                      env_float("YOLO_LATENCY_BUDGET_MS", 0.f));
+
+        // stage histograms and counters, written only by this thread
+        ThreadMetrics* metrics = metrics_registry().add_thread(fs::path(cam_dev).filename().string());
+        uint64_t last_bus_seq = 0;
+        trace_thread_name("cam " + fs::path(cam_dev).filename().string());
+
+        // "shm:/yolo_video0" reads the frames YoloV8Capture publishes instead of opening the device
+        bool use_bus = cam_dev.compare(0, 4, "shm:") == 0;
+        std::string bus_name = use_bus ? cam_dev.substr(4) : "";
+        FrameBusReader bus;
+        FrameView view;
+        cv::VideoCapture cap;
+
+        if (use_bus) {
+            if (!bus.attach(bus_name)) {
+                std::cerr << "[ERR] Cannot attach frame bus " << bus_name << std::endl;
+                return;
+            }
+        } else {
+            cap.open(cam_dev, cv::CAP_V4L2);
+            cap.set(cv::CAP_PROP_FRAME_WIDTH, env_int("YOLO_CAPTURE_W", 640));
+            cap.set(cv::CAP_PROP_FRAME_HEIGHT, env_int("YOLO_CAPTURE_H", 480));
+            cap.set(cv::CAP_PROP_FPS, 30);
+
+            if (!cap.isOpened()) {
+                std::cerr << "[ERR] Cannot open camera " << cam_dev << std::endl;
+                return;
+            }
         }
         std::cout << "[INFO] Camera thread " << thread_id << " opened " << cam_dev << std::endl;
 
+        // static regions where people can appear, loaded once the frame size is known
+        RoiMask roi;
+        bool roi_loaded = false;
+
+        // tiled inference for captures well above target_size, optionally only where something moved
+        int tile_size = env_int("YOLO_TILE_SIZE", 0);
+        bool use_motion = env_int("YOLO_MOTION", 0) != 0;
+        MotionMask motion;
+
+        // annotated MJPEG stream, one port per camera; costs nothing while nobody is connected
+        MjpegServer preview;
+        int preview_port = env_int("YOLO_PREVIEW_PORT", 0);
+        if (preview_port > 0) {
+            if (preview.start(preview_port + thread_id))
+                std::cout << "[INFO] Preview for " << cam_dev << " on port " << preview_port + thread_id << std::endl;
+            else
+                std::cerr << "[ERR] Cannot listen on preview port " << preview_port + thread_id << std::endl;
+        }
+
+        warmup.get();
+
+        // the process-wide thermal governor's level last applied to this camera
+        int governor_level = 0;
+
         cv::Mat frame;
         // Minimal local counters for FPS smoothing
         int frame_count = 0;
@@ -161,15 +264,33 @@ void camera_thread_func(const std::string cam_dev, int thread_id, int target_siz
         double avg_total_ms = 0.0;
         double avg_fps = 0.0;
         auto t_last_fps = high_resolution_clock::now();
+        auto t_last_report = t_last_fps;
 
         while (!stop_all) {
             // Capture
             auto t0 = high_resolution_clock::now();
-            bool ok = cap.read(frame);
+            int64_t tr_capture = trace_enabled() ? trace_now_ns() : 0;
+            bool ok;
+            if (use_bus) {
+                ok = bus.acquire(view, 500);
+                if (ok) {
+                    frame = view.mat; // zero-copy, valid until bus.release()
+                    if (last_bus_seq && view.seq > last_bus_seq + 1)
+                        metrics->count(COUNTER_FRAMES_SKIPPED, view.seq - last_bus_seq - 1);
+                    last_bus_seq = view.seq;
+                } else
+                    bus.attach(bus_name); // follow a restarted publisher
+            } else {
+                ok = cap.read(frame);
+            }
             if (!ok || frame.empty()) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(2));
                 continue;
             }
+            // the frame's trace id, carried to the logger in FrameResult
+            uint64_t frame_id = trace_new_frame();
+            if (frame_id)
+                trace_complete(use_bus ? "bus_acquire" : "cap_read", frame_id, tr_capture, trace_now_ns());
             // Keep a light-weight copy for saving crops (logger will clone as needed)
             // Resize small preview copy to reduce logger IO size (optional)
             cv::Mat save_frame_small;
@@ -183,13 +304,65 @@ void camera_thread_func(const std::string cam_dev, int thread_id, int target_siz
 
             auto t_capture_done = high_resolution_clock::now();
             double capture_ms = duration_cast<microseconds>(t_capture_done - t0).count() / 1000.0;
+            metrics->record(STAGE_CAPTURE, capture_ms);
+
+            if (!roi_loaded) {
+                roi_loaded = true;
+                std::string roi_path = env_str("YOLO_ROI_DIR", ".") + "/" + fs::path(cam_dev).filename().string() + ".roi";
+                if (roi.load(roi_path, frame.cols, frame.rows)) {
+                    const cv::Rect& b = roi.bounds();
+                    std::cout << "[ROI " << cam_dev << "] " << roi_path << ": crop " << b.width << "x" << b.height
+                              << " at " << b.x << "," << b.y << " = " << std::fixed << std::setprecision(1)
+                              << 100.0 * roi.crop_fraction() << "% of frame pixels, input "
+                              << yolo.region_target_size(frame.cols, frame.rows, b) << " of " << target_size << std::endl;
+                }
+            }
+
+            if (governor.update())
+                governor.log_transition(std::cout, "soc");
+            if (governor.level_index() != governor_level) {
+                governor_level = governor.level_index();
+                yolo.set_num_threads(governor.level().num_threads);
+                res_ctrl.set_size_cap(governor.level().max_size);
+            }
 
             // Perform detection (this is the main cost)
+            int input_size = res_ctrl.size();
+            yolo.set_target_size(input_size);
             auto t_infer_start = high_resolution_clock::now();
+            int64_t tr_detect = frame_id ? trace_now_ns() : 0;
             std::vector<Object> objs;
-            yolo.detect(frame, objs, conf_thresh, 0.45f); // conf, nms
+            if (tile_size > 0) {
+                const cv::Mat& active = use_motion ? motion.update(frame, roi.mask()) : roi.mask();
+                yolo.detect_tiled(frame, objs, tile_size, 0.2f, active, conf_thresh, 0.45f);
+            } else {
+                yolo.detect(frame, roi.bounds(), objs, conf_thresh, 0.45f); // conf, nms; whole frame without roi
+            }
+            roi.filter(objs);
             auto t_infer_end = high_resolution_clock::now();
             double infer_ms = duration_cast<microseconds>(t_infer_end - t_infer_start).count() / 1000.0;
+            if (frame_id) {
+                // stage spans are exact for detect(), per-stage sums over the tiles for detect_tiled()
+                const DetectTimings& dt = yolo.last_timings();
+                trace_complete("detect", frame_id, tr_detect, trace_now_ns());
+                trace_sequence(frame_id, tr_detect, {{"preprocess", dt.preprocess_ms}, {"inference", dt.inference_ms},
+                                                     {"decode", dt.decode_ms}, {"nms", dt.nms_ms}});
+            }
+            res_ctrl.update(infer_ms);
+
+            if (first_detection) {
+                first_detection = false;
+                std::cout << "[INFO] " << cam_dev << " first detection " << std::fixed << std::setprecision(0)
+                          << duration_cast<microseconds>(t_infer_end - t_process_start).count() / 1000.0
+                          << " ms after start (model " << yolo.model_source() << " " << yolo.load_ms() << " ms, warm-up "
+                          << warmup_runs << "x " << warmup_ms << " ms, this frame " << std::setprecision(1) << infer_ms << " ms)" << std::endl;
+            }
+
+            const DetectTimings& dt = yolo.last_timings();
+            metrics->record(STAGE_PREPROCESS, dt.preprocess_ms);
+            metrics->record(STAGE_INFERENCE, dt.inference_ms);
+            metrics->record(STAGE_DECODE, dt.decode_ms);
+            metrics->record(STAGE_NMS, dt.nms_ms);
 
             // Build FrameResult
             FrameResult res;
@@ -197,6 +370,7 @@ void camera_thread_func(const std::string cam_dev, int thread_id, int target_siz
             res.ts_ms = now_ms();
             res.capture_ms = capture_ms;
             res.infer_ms = infer_ms;
+            res.input_size = input_size;
             res.total_ms = duration_cast<microseconds>(high_resolution_clock::now() - t0).count() / 1000.0;
 
             // Extract only humans
@@ -209,15 +383,37 @@ void camera_thread_func(const std::string cam_dev, int thread_id, int target_siz
                 }
             }
             res.human_count = (int)res.persons.size();
+            metrics->count(COUNTER_FRAMES);
+            metrics->count(COUNTER_HUMANS, res.human_count);
+
+            if (preview.has_viewers()) {
+                TraceSpan trace_preview("preview_submit", frame_id);
+                preview.submit(frame, objs, cv::format("size: %d  humans: %d", input_size, res.human_count));
+            }
+
+            // A bus frame is only borrowed: the logger gets its own copy, and only when it will save crops
+            if (use_bus) {
+                if (save_scale == 1.0)
+                    save_frame_small = (res.human_count > 0) ? frame.clone() : cv::Mat();
+                frame.release();
+                bus.release(view);
+            }
 
             // Put small frame for saving (move)
             res.frame_for_save = std::move(save_frame_small);
+            res.save_scale = save_scale;
+            res.frame_id = frame_id;
 
             {
                 std::lock_guard<std::mutex> lock(q_mutex);
+                res.t_queued = high_resolution_clock::now();
+                res.queued_ns = frame_id ? trace_now_ns() : 0;
                 results_q.push_back(std::move(res));
                 // keep queue bounded to avoid memory growth
-                if (results_q.size() > 200) results_q.pop_front();
+                if (results_q.size() > 200) {
+                    results_q.pop_front();
+                    metrics->count(COUNTER_QUEUE_DROPPED);
+                }
             }
 
             // Local debug print: one line per second
@@ -228,14 +424,27 @@ void camera_thread_func(const std::string cam_dev, int thread_id, int target_siz
                 double fps = frame_count / std::max(1.0, duration_cast<milliseconds>(now - t_last_fps).count() / 1000.0);
                 std::cout << "[CAM " << cam_dev << "] FPS: " << std::fixed << std::setprecision(1) << fps
                           << " | infer_ms: " << std::fixed << std::setprecision(1) << infer_ms
-                          << " | humans: " << res.human_count << std::endl;
+                          << " | size: " << input_size;
+                if (tile_size > 0)
+                    std::cout << " | tiles: " << yolo.last_tiles_run() << "/" << yolo.last_tiles_total();
+                std::cout << " | humans: " << res.human_count << std::endl;
                 frame_count = 0;
                 t_last_fps = now;
             }
+            // latency/FPS tradeoff per input size, once a minute
+            if (res_ctrl.enabled() && duration_cast<seconds>(now - t_last_report).count() >= 60) {
+                res_ctrl.report(std::cout, cam_dev);
+                t_last_report = now;
+            }
 
-            // Minimal delay: let thread yield
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // Minimal delay: let thread yield; the governor may cap the frame rate
+            int interval_ms = governor.frame_interval_ms();
+            if (interval_ms > 0)
+                std::this_thread::sleep_until(t0 + milliseconds(interval_ms));
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+        res_ctrl.report(std::cout, cam_dev);
     } catch (const std::exception &e) {
         std::cerr << "[EXC] camera thread " << cam_dev << " : " << e.what() << std::endl;
     }
@@ -248,22 +457,69 @@ int main(int argc, char** argv) {
     ensure_dirs();
     stop_all = false;
 
+    // Ctrl-C / kill: let the threads finish their frame so reports and the trace get written
+    std::signal(SIGINT, [](int) { stop_all = true; });
+    std::signal(SIGTERM, [](int) { stop_all = true; });
+
+    std::string trace_path = env_str("YOLO_TRACE", "");
+    if (!trace_path.empty())
+        trace_start(env_int("YOLO_TRACE_EVENTS", 1 << 16));
+
+    // scraped on demand; recording is always on and costs a few ns per stage
+    MetricsServer metrics_server;
+    metrics_registry().add_gauge("yolo_queue_depth", "queue=\"results\"", [] {
+        std::lock_guard<std::mutex> lock(q_mutex);
+        return (double)results_q.size();
+    });
+    // read at scrape time, independent of the governor
+    static SysfsThermal thermal(env_str("YOLO_SYSFS_ROOT", "/sys"));
+    metrics_registry().add_gauge("yolo_cpu_temp_celsius", "zone=\"0\"", [] {
+        ThermalSample ts;
+        return thermal.read(ts) ? ts.temp_c : 0.0;
+    });
+    metrics_registry().add_gauge("yolo_cpu_freq_mhz", "cpu=\"0\"", [] {
+        ThermalSample ts;
+        return thermal.read(ts) ? ts.cur_khz / 1000.0 : 0.0;
+    });
+    int metrics_port = env_int("YOLO_METRICS_PORT", 0);
+    if (metrics_port > 0) {
+        if (metrics_server.start(metrics_port))
+            std::cout << "[INFO] Metrics on http://0.0.0.0:" << metrics_port << "/metrics" << std::endl;
+        else
+            std::cerr << "[ERR] Cannot listen on metrics port " << metrics_port << std::endl;
+    }
+
     // Launch logger thread
     std::thread logger_thread(logger_thread_func);
 
+    // backs off threads, then input size, then frame rate before the SoC throttles (off unless configured);
+    // one governor for both cameras: they share the SoC, so they step together
+    ThermalGovernor governor(env_str("YOLO_SYSFS_ROOT", "/sys"), env_float("YOLO_TEMP_LIMIT", 0.f),
+                             YoloV8::default_option(env_str("YOLO_MODEL", "yolov8n").c_str(), 2).num_threads,
+                             candidate_sizes(env_int_list("YOLO_SIZES", {320, 416, 512, 640}), 640), 30.f);
+
     // Launch two camera threads
-    std::thread t0(camera_thread_func, cam0, 0, 640, 0.35f);
-    std::thread t1(camera_thread_func, cam1, 1, 640, 0.35f);
+    std::thread t0(camera_thread_func, cam0, 0, std::ref(governor), 640, 0.35f);
+    std::thread t1(camera_thread_func, cam1, 1, std::ref(governor), 640, 0.35f);
 
     std::cout << "Press Ctrl-C to stop\n";
 
     // wait for Ctrl-C (or manual interrupt)
-    // simple join loop; set stop_all=true externally if you prefer signals
     t0.join();
     t1.join();
 
     stop_all = true;
     logger_thread.join();
+    if (governor.enabled())
+        governor.report(std::cout, "soc");
+
+    if (!trace_path.empty()) {
+        trace_stop();
+        if (trace_dump(trace_path))
+            std::cout << "[INFO] Trace written to " << trace_path << std::endl;
+        else
+            std::cerr << "[ERR] Cannot write trace " << trace_path << std::endl;
+    }
 
     return 0;
 }
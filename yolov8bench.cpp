@@ -0,0 +1,777 @@
+// yolov8bench.cpp
+// Offline benchmarks for detector variants, one mode per comparison.
+// Compile with: g++ yoloV8.cpp ncnn_profile.cpp roi_mask.cpp frame_bus.cpp http_util.cpp metrics.cpp frame_trace.cpp resolution_controller.cpp thermal_governor.cpp yolov8bench.cpp -o YoloV8Bench `pkg-config --cflags --libs opencv4` -lrt -I /home/pi/ncnn/build/install/include/ncnn -L /home/pi/ncnn/build/install/lib -lncnn -fopenmp -lpthread -O3 -std=c++17
+// Usage:
+//   ./YoloV8Bench prune <full model> <pruned model> [image ...]
+//   ./YoloV8Bench roi <model> <region file> [image ...]
+//   ./YoloV8Bench tiles <model> <tile size> <image> [gt.txt] ...
+//     each image may be followed by a .txt with one person per line "x y w h"
+//   ./YoloV8Bench framebus [seconds=5] [width=640] [height=480]
+//   ./YoloV8Bench metrics [model] [image]
+//   ./YoloV8Bench trace [model] [image]
+//   ./YoloV8Bench startup <model> [runs=5] [image]
+//     add/remove ./<model>.param.bin (ncnn2mem) to compare mapped and text loading
+//   ./YoloV8Bench thermal <model> [minutes=30] [temp limit=75] [image]
+//     two 30 fps camera loads, governor off then on; run in the enclosure
+//   ./YoloV8Bench resolution
+//     replays cool/hot/cool detect() latencies through ResolutionController, no model needed
+
+#include "yoloV8.h"
+#include "roi_mask.h"
+#include "frame_bus.h"
+#include "metrics.h"
+#include "frame_trace.h"
+#include "resolution_controller.h"
+#include "thermal_governor.h"
+#include "env_config.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono;
+
+static const int bench_runs = 10;
+// keeps read loops from being optimised away
+static volatile uint64_t bench_sink;
+
+// median wall time of fn() in ms after two warm-up calls
+static double median_ms(const std::function<void()>& fn, int runs = bench_runs)
+{
+    fn();
+    fn();
+    std::vector<double> ms;
+    for (int i = 0; i < runs; i++) {
+        auto t0 = steady_clock::now();
+        fn();
+        ms.push_back(duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0);
+    }
+    std::sort(ms.begin(), ms.end());
+    return ms[ms.size() / 2];
+}
+
+static std::vector<cv::Mat> load_images(int argc, char** argv, int first)
+{
+    std::vector<cv::Mat> images;
+    for (int i = first; i < argc; i++) {
+        cv::Mat img = cv::imread(argv[i]);
+        if (img.empty())
+            std::cerr << "[WARN] Cannot read " << argv[i] << std::endl;
+        else
+            images.push_back(img);
+    }
+    if (images.empty()) {
+        // no images given: a textured 640x480 frame still times the network
+        cv::Mat frame(480, 640, CV_8UC3);
+        for (int y = 0; y < frame.rows; y++) {
+            unsigned char* p = frame.ptr<unsigned char>(y);
+            for (int x = 0; x < frame.cols * 3; x++)
+                p[x] = (unsigned char)((x * 7 + y * 13 + (x * y) % 31) & 0xff);
+        }
+        images.push_back(frame);
+    }
+    return images;
+}
+
+static float iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b)
+{
+    float inter = (a & b).area();
+    float uni = a.area() + b.area() - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+static std::vector<Object> persons_only(const std::vector<Object>& objs)
+{
+    std::vector<Object> persons;
+    for (auto& o : objs)
+        if (o.label == 0) persons.push_back(o);
+    return persons;
+}
+
+// padded network input for a cols x rows image, as detect() letterboxes it
+static cv::Size input_shape(int cols, int rows, int target_size)
+{
+    float scale = (float)target_size / std::max(cols, rows);
+    return cv::Size((int)(cols * scale + 31) / 32 * 32, (int)(rows * scale + 31) / 32 * 32);
+}
+
+static int bench_prune(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " prune <full model> <pruned model> [image ...]\n";
+        return -1;
+    }
+    const int target_size = 640;
+    std::vector<cv::Mat> images = load_images(argc, argv, 4);
+
+    YoloV8 full, pruned;
+    if (full.load(target_size, argv[2]) != 0 || pruned.load(target_size, argv[3]) != 0) {
+        std::cerr << "[ERR] Cannot load " << argv[2] << " or " << argv[3] << std::endl;
+        return -1;
+    }
+
+    double full_ms = 0.0, pruned_ms = 0.0;
+    int matched = 0, only_full = 0, only_pruned = 0;
+    float min_iou = 1.f, max_dprob = 0.f;
+
+    for (const cv::Mat& img : images) {
+        std::vector<Object> a, b;
+        full_ms += median_ms([&] { full.detect(img, a); });
+        pruned_ms += median_ms([&] { pruned.detect(img, b); });
+
+        // the full model may label a box as another class (argmax over 80)
+        // and its class-agnostic NMS may let that box suppress a person
+        std::vector<Object> pa = persons_only(a), pb = persons_only(b);
+        std::vector<bool> used(pb.size(), false);
+        for (auto& p : pa) {
+            int best = -1;
+            float best_iou = 0.5f;
+            for (size_t j = 0; j < pb.size(); j++) {
+                float v = iou(p.rect, pb[j].rect);
+                if (!used[j] && v > best_iou) { best = j; best_iou = v; }
+            }
+            if (best < 0) { only_full++; continue; }
+            used[best] = true;
+            matched++;
+            min_iou = std::min(min_iou, best_iou);
+            max_dprob = std::max(max_dprob, std::fabs(p.prob - pb[best].prob));
+        }
+        only_pruned += std::count(used.begin(), used.end(), false);
+    }
+
+    int n = images.size();
+    // output blob as extracted for the first image; its rows must match the classes file
+    std::vector<Object> objs;
+    full.detect(images[0], objs);
+    pruned.detect(images[0], objs);
+    size_t full_bytes = full.last_output_bytes();
+    size_t pruned_bytes = pruned.last_output_bytes();
+    for (const YoloV8* y : {&full, &pruned}) {
+        if (y->last_output_w() != 64 + y->num_classes()) {
+            std::cerr << "[ERR] " << (y == &full ? argv[2] : argv[3]) << " output w " << y->last_output_w()
+                      << " != 64 + " << y->num_classes() << " classes" << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "[PRUNE] images: " << n << "\n"
+              << "[PRUNE] infer_ms   full " << full_ms / n << "  pruned " << pruned_ms / n
+              << "  (" << 100.0 * (1.0 - pruned_ms / full_ms) << "% faster)\n"
+              << "[PRUNE] output     full " << full_bytes / 1024.0 << " KiB  pruned " << pruned_bytes / 1024.0
+              << " KiB  (" << full.num_classes() << " -> " << pruned.num_classes() << " classes)\n"
+              << "[PRUNE] persons    matched " << matched << "  only_full " << only_full
+              << "  only_pruned " << only_pruned << "  min_iou " << (matched ? min_iou : 0.f)
+              << "  max_dprob " << max_dprob << std::endl;
+
+    return (only_full == 0) ? 0 : 1;
+}
+
+static int bench_roi(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " roi <model> <region file> [image ...]\n";
+        return -1;
+    }
+    const int target_size = 640;
+    std::vector<cv::Mat> images = load_images(argc, argv, 4);
+
+    YoloV8 yolo;
+    if (yolo.load(target_size, argv[2]) != 0) {
+        std::cerr << "[ERR] Cannot load " << argv[2] << std::endl;
+        return -1;
+    }
+
+    double full_ms = 0.0, roi_ms = 0.0, src_frac = 0.0, in_frac = 0.0;
+    int full_persons = 0, roi_persons = 0;
+    for (const cv::Mat& img : images) {
+        RoiMask roi;
+        if (!roi.load(argv[3], img.cols, img.rows)) {
+            std::cerr << "[ERR] No region in " << argv[3] << std::endl;
+            return -1;
+        }
+
+        std::vector<Object> a, b;
+        full_ms += median_ms([&] { yolo.detect(img, a); });
+        roi_ms += median_ms([&] { yolo.detect(img, roi.bounds(), b); roi.filter(b); });
+
+        // full-frame detections that the mask would keep, for comparison
+        roi.filter(a);
+        full_persons += persons_only(a).size();
+        roi_persons += persons_only(b).size();
+
+        cv::Size full_in = input_shape(img.cols, img.rows, target_size);
+        const cv::Rect& r = roi.bounds();
+        cv::Size roi_in = input_shape(r.width, r.height, yolo.region_target_size(img.cols, img.rows, r));
+        src_frac += roi.crop_fraction();
+        in_frac += (double)roi_in.area() / full_in.area();
+    }
+
+    int n = images.size();
+    std::cout << std::fixed << std::setprecision(2)
+              << "[ROI] images: " << n << "\n"
+              << "[ROI] pixels     source " << 100.0 * src_frac / n << "%  network input " << 100.0 * in_frac / n << "% of full frame\n"
+              << "[ROI] infer_ms   full " << full_ms / n << "  roi " << roi_ms / n
+              << "  (" << 100.0 * (1.0 - roi_ms / full_ms) << "% faster)\n"
+              << "[ROI] persons    full+mask " << full_persons << "  roi " << roi_persons << std::endl;
+
+    return 0;
+}
+
+// fraction of gt boxes matched by a person detection at iou >= 0.5
+static void count_recall(const std::vector<cv::Rect_<float>>& gt, const std::vector<Object>& dets,
+                         float small_h, int& hit, int& small_total, int& small_hit)
+{
+    std::vector<Object> persons = persons_only(dets);
+    std::vector<bool> used(persons.size(), false);
+    for (auto& g : gt) {
+        bool small = g.height < small_h;
+        small_total += small;
+        for (size_t j = 0; j < persons.size(); j++) {
+            if (!used[j] && iou(g, persons[j].rect) >= 0.5f) {
+                used[j] = true;
+                hit++;
+                small_hit += small;
+                break;
+            }
+        }
+    }
+}
+
+static int bench_tiles(int argc, char** argv)
+{
+    if (argc < 5) {
+        std::cerr << "usage: " << argv[0] << " tiles <model> <tile size> <image> [gt.txt] ...\n";
+        return -1;
+    }
+    const int target_size = 640;
+    int tile_size = atoi(argv[3]);
+
+    YoloV8 yolo;
+    if (yolo.load(target_size, argv[2]) != 0) {
+        std::cerr << "[ERR] Cannot load " << argv[2] << std::endl;
+        return -1;
+    }
+
+    double single_ms = 0.0, tiled_ms = 0.0;
+    int n = 0, gt_total = 0, single_hit = 0, tiled_hit = 0;
+    int small_total = 0, single_small = 0, tiled_small = 0, dummy = 0;
+    int tiles = 0;
+
+    // arguments are image paths, each optionally followed by its .txt ground truth
+    for (int i = 4; i < argc; i++) {
+        cv::Mat img = cv::imread(argv[i]);
+        if (img.empty()) {
+            std::cerr << "[WARN] Cannot read " << argv[i] << std::endl;
+            continue;
+        }
+        std::vector<cv::Rect_<float>> gt;
+        if (i + 1 < argc && std::string(argv[i + 1]).find(".txt") != std::string::npos) {
+            std::ifstream f(argv[++i]);
+            float x, y, w, h;
+            while (f >> x >> y >> w >> h)
+                gt.push_back(cv::Rect_<float>(x, y, w, h));
+        }
+
+        std::vector<Object> a, b;
+        single_ms += median_ms([&] { yolo.detect(img, a); });
+        tiled_ms += median_ms([&] { yolo.detect_tiled(img, b, tile_size); });
+        tiles = yolo.last_tiles_total();
+        n++;
+
+        // "small": under 32 px tall once the whole frame is squeezed into target_size
+        float small_h = 32.f * std::max(img.cols, img.rows) / target_size;
+        gt_total += gt.size();
+        count_recall(gt, a, small_h, single_hit, small_total, single_small);
+        count_recall(gt, b, small_h, tiled_hit, dummy, tiled_small);
+    }
+    if (n == 0) return -1;
+
+    auto pct = [](int a, int b) { return b ? 100.0 * a / b : 0.0; };
+    std::cout << std::fixed << std::setprecision(2)
+              << "[TILES] images: " << n << "  tiles/frame: " << tiles << " of " << tile_size << " px\n"
+              << "[TILES] infer_ms  single " << single_ms / n << " (" << 1000.0 * n / single_ms << " FPS)"
+              << "  tiled " << tiled_ms / n << " (" << 1000.0 * n / tiled_ms << " FPS)\n";
+    if (gt_total)
+        std::cout << "[TILES] recall    single " << pct(single_hit, gt_total) << "%  tiled " << pct(tiled_hit, gt_total)
+                  << "%  (" << gt_total << " persons)\n"
+                  << "[TILES] small     single " << pct(single_small, small_total) << "%  tiled " << pct(tiled_small, small_total)
+                  << "%  (" << small_total << " persons)\n";
+    std::cout << std::flush;
+
+    return 0;
+}
+
+// child process: reads every frame it gets in full, reports latency and bandwidth
+static void framebus_reader(const std::string& name, int id)
+{
+    FrameBusReader bus;
+    for (int i = 0; i < 100 && !bus.attach(name); i++)
+        std::this_thread::sleep_for(milliseconds(10));
+
+    std::vector<double> lat_us;
+    uint64_t last_seq = 0, skipped = 0, sum = 0;
+    double bytes = 0.0;
+    auto t_first = steady_clock::now(), t_last = t_first;
+    FrameView view;
+    while (bus.acquire(view, 500)) {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        lat_us.push_back(((int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec - view.ts_ns) / 1000.0);
+        if (lat_us.size() == 1) t_first = steady_clock::now();
+
+        // touch every cache line, like a consumer that looks at the whole frame
+        size_t n = view.mat.rows * view.mat.cols * view.mat.elemSize();
+        for (size_t i = 0; i < n; i += 64)
+            sum += view.mat.data[i];
+        bytes += n;
+
+        if (last_seq && view.seq > last_seq + 1) skipped += view.seq - last_seq - 1;
+        last_seq = view.seq;
+        bus.release(view);
+        t_last = steady_clock::now();
+    }
+    if (lat_us.empty()) return;
+
+    std::sort(lat_us.begin(), lat_us.end());
+    double secs = std::max(1e-3, duration_cast<microseconds>(t_last - t_first).count() / 1e6);
+    std::cout << std::fixed << std::setprecision(1)
+              << "[BUS]   reader " << id << "  frames " << lat_us.size() << "  skipped " << skipped
+              << "  latency_us p50 " << lat_us[lat_us.size() / 2] << " p99 " << lat_us[lat_us.size() * 99 / 100]
+              << "  read MB/s " << bytes / secs / 1e6 << std::endl;
+    bench_sink = sum;
+}
+
+static int bench_framebus(int argc, char** argv)
+{
+    int seconds = (argc > 2) ? atoi(argv[2]) : 5;
+    int width = (argc > 3) ? atoi(argv[3]) : 640;
+    int height = (argc > 4) ? atoi(argv[4]) : 480;
+    const std::string name = "/yolo_bench";
+
+    cv::Mat frame(height, width, CV_8UC3);
+    for (int readers = 1; readers <= 4; readers++) {
+        FrameBusPublisher bus;
+        if (!bus.open(name, width, height, CV_8UC3, readers + 2)) {
+            std::cerr << "[ERR] Cannot create frame bus " << name << std::endl;
+            return -1;
+        }
+
+        std::vector<pid_t> children;
+        for (int r = 0; r < readers; r++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                framebus_reader(name, r);
+                _exit(0);
+            }
+            children.push_back(pid);
+        }
+        std::this_thread::sleep_for(milliseconds(200));
+
+        // 30 fps camera
+        int frames = seconds * 30;
+        double publish_ms = 0.0;
+        for (int i = 0; i < frames; i++) {
+            memset(frame.data, i & 0xff, (size_t)width * height * 3);
+            auto t0 = steady_clock::now();
+            bus.publish(frame, i + 1);
+            publish_ms += duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0;
+            std::this_thread::sleep_until(t0 + microseconds(33333));
+        }
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "[BUS] readers " << readers << "  publish_ms " << publish_ms / frames
+                  << "  write MB/s " << std::setprecision(1) << frames * bus.frame_bytes() / (double)seconds / 1e6
+                  << "  dropped " << bus.dropped() << std::endl;
+
+        bus.close();
+        for (pid_t pid : children)
+            waitpid(pid, nullptr, 0);
+    }
+
+    return 0;
+}
+
+// ns per call of fn, over n calls
+static double ns_per_call(const std::function<void(int)>& fn, int n)
+{
+    auto t0 = steady_clock::now();
+    for (int i = 0; i < n; i++)
+        fn(i);
+    return duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (double)n;
+}
+
+static int bench_metrics(int argc, char** argv)
+{
+    const int n = 2000000;
+    MetricsRegistry registry;
+
+    // spread of values like real stage times, 50 us .. 200 ms
+    std::vector<double> ms(4096);
+    for (size_t i = 0; i < ms.size(); i++)
+        ms[i] = 0.05 * std::pow(4000.0, (double)((i * 2654435761u) % 4096) / 4096.0);
+
+    ThreadMetrics* m = registry.add_thread("bench");
+    double clock_ns = ns_per_call([](int) { bench_sink = steady_clock::now().time_since_epoch().count(); }, n);
+    double record_ns = ns_per_call([&](int i) { m->record((MetricStage)(i % STAGE_COUNT), ms[i & 4095]); }, n);
+    double count_ns = ns_per_call([&](int) { m->count(COUNTER_FRAMES); }, n);
+
+    // one writer per core: each owns its ThreadMetrics, so there is nothing to contend on
+    int writers = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    std::vector<double> parallel_ns(writers);
+    for (int w = 0; w < writers; w++) {
+        ThreadMetrics* tm = registry.add_thread("writer" + std::to_string(w));
+        threads.emplace_back([&, tm, w] {
+            parallel_ns[w] = ns_per_call([&](int i) { tm->record((MetricStage)(i % STAGE_COUNT), ms[i & 4095]); }, n);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    std::sort(parallel_ns.begin(), parallel_ns.end());
+
+    std::string page;
+    double render_ms = median_ms([&] { page = registry.render(); });
+
+    // per frame a camera thread reads the clock ~10 times, records 5 stages and bumps 2 counters
+    double frame_ns = 10 * clock_ns + 5 * record_ns + 2 * count_ns;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "[METRICS] clock read " << clock_ns << " ns, record " << record_ns << " ns, count " << count_ns << " ns" << std::endl
+              << "[METRICS] record with " << writers << " writer threads: " << parallel_ns.front() << " .. " << parallel_ns.back() << " ns" << std::endl
+              << "[METRICS] per frame " << frame_ns / 1000.0 << " us" << std::endl
+              << std::setprecision(2)
+              << "[METRICS] scrape " << render_ms << " ms for " << page.size() / 1024 << " KiB (" << writers + 1 << " threads)" << std::endl;
+
+    if (argc > 2) {
+        YoloV8 yolo;
+        if (yolo.load(640, argv[2]) != 0) {
+            std::cerr << "[ERR] Cannot load " << argv[2] << std::endl;
+            return -1;
+        }
+        std::vector<cv::Mat> images = load_images(argc, argv, 3);
+        std::vector<Object> objs;
+        double detect_ms = median_ms([&] { yolo.detect(images[0], objs, 0.35f, 0.45f); });
+        std::cout << "[METRICS] detect " << detect_ms << " ms, overhead " << std::setprecision(4)
+                  << 100.0 * frame_ns / (detect_ms * 1e6) << "% of a frame" << std::endl;
+    }
+
+    return 0;
+}
+
+static int bench_trace(int argc, char** argv)
+{
+    const int n = 2000000;
+
+    double off_ns = ns_per_call([](int i) { TraceSpan span("bench", i); }, n);
+    trace_start(1 << 16);
+    trace_thread_name("bench");
+    double now_ns = ns_per_call([](int) { bench_sink = trace_now_ns(); }, n);
+    double span_ns = ns_per_call([](int i) { TraceSpan span("bench", i); }, n);
+    double frame_id_ns = ns_per_call([](int) { bench_sink = trace_new_frame(); }, n);
+
+    // per frame the camera thread records ~9 spans from ~6 clock reads, the logger 2
+    double frame_ns = 6 * now_ns + 11 * (span_ns - 2 * now_ns) + frame_id_ns;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "[TRACE] off: span " << off_ns << " ns" << std::endl
+              << "[TRACE] on:  clock " << now_ns << " ns, span " << span_ns << " ns, frame id " << frame_id_ns << " ns" << std::endl
+              << "[TRACE] per frame " << frame_ns / 1000.0 << " us" << std::endl;
+
+    auto t0 = steady_clock::now();
+    trace_dump("/tmp/yolov8bench_trace.json");
+    std::cout << "[TRACE] dump of " << (1 << 16) << " events " << duration_cast<milliseconds>(steady_clock::now() - t0).count() << " ms" << std::endl;
+
+    if (argc > 2) {
+        // the same detect loop with tracing off and on, spans as in YoloV8Dual
+        YoloV8 yolo;
+        if (yolo.load(640, argv[2]) != 0) {
+            std::cerr << "[ERR] Cannot load " << argv[2] << std::endl;
+            return -1;
+        }
+        std::vector<cv::Mat> images = load_images(argc, argv, 3);
+        std::vector<Object> objs;
+        auto traced_detect = [&] {
+            uint64_t id = trace_new_frame();
+            int64_t t = trace_enabled() ? trace_now_ns() : 0;
+            yolo.detect(images[0], objs, 0.35f, 0.45f);
+            if (id) {
+                const DetectTimings& dt = yolo.last_timings();
+                trace_complete("detect", id, t, trace_now_ns());
+                trace_sequence(id, t, {{"preprocess", dt.preprocess_ms}, {"inference", dt.inference_ms},
+                                       {"decode", dt.decode_ms}, {"nms", dt.nms_ms}});
+            }
+        };
+        trace_stop();
+        double plain_ms = median_ms(traced_detect, 30);
+        trace_start(1 << 16);
+        double traced_ms = median_ms(traced_detect, 30);
+        trace_stop();
+        std::cout << std::setprecision(2) << "[TRACE] detect median " << plain_ms << " ms off, " << traced_ms << " ms on" << std::endl;
+    }
+
+    return 0;
+}
+
+// child process: a cold start as after pkill, load -> warm-up -> first real frame
+static void startup_run(const char* model, const cv::Mat& img, int warmup_runs)
+{
+    auto t0 = steady_clock::now();
+    YoloV8 yolo;
+    if (yolo.load(640, model) != 0) {
+        std::cerr << "[ERR] Cannot load " << model << std::endl;
+        return;
+    }
+    auto t_load = steady_clock::now();
+    yolo.warmup(img.cols, img.rows, warmup_runs);
+    auto t_warm = steady_clock::now();
+
+    std::vector<Object> objs;
+    yolo.detect(img, objs, 0.35f, 0.45f);
+    auto t_first = steady_clock::now();
+    yolo.detect(img, objs, 0.35f, 0.45f);
+    auto t_second = steady_clock::now();
+
+    auto ms = [](steady_clock::time_point a, steady_clock::time_point b) { return duration_cast<microseconds>(b - a).count() / 1000.0; };
+    std::cout << std::fixed << std::setprecision(1)
+              << "[START] " << yolo.model_source() << " warm-up " << warmup_runs << "  load " << ms(t0, t_load)
+              << "  warm-up " << ms(t_load, t_warm) << "  first frame " << ms(t_warm, t_first)
+              << "  second frame " << ms(t_first, t_second) << "  first detection at " << ms(t0, t_first) << " ms" << std::endl;
+}
+
+static int bench_startup(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " startup <model> [runs=5] [image]\n";
+        return -1;
+    }
+    int runs = (argc > 3) ? std::max(1, atoi(argv[3])) : 5;
+    std::vector<cv::Mat> images = load_images(argc, argv, 4);
+
+    // each run in a fresh process, the page cache stays warm like on a restart
+    for (int warmup_runs : {0, 1, 2}) {
+        for (int r = 0; r < runs; r++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                startup_run(argv[2], images[0], warmup_runs);
+                fflush(stdout);
+                _exit(0);
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    return 0;
+}
+
+struct ThermalRun
+{
+    std::mutex mutex;
+    std::vector<double> latency_ms; // this minute, all cameras
+    long long frames = 0;
+    int max_level = 0;
+    int transitions = 0;
+};
+
+// one camera thread: 30 fps cap like the real capture, the shared governor's level applied per frame
+static void thermal_camera(const char* model, const cv::Mat& img, ThermalGovernor& governor, int seconds, ThermalRun& run)
+{
+    YoloV8 yolo;
+    if (yolo.load(640, model, 2) != 0)
+        return;
+    ResolutionController res_ctrl({320, 416, 512, 640}, 640, 0.f);
+    int governor_level = 0;
+
+    auto t_end = steady_clock::now() + std::chrono::seconds(seconds);
+    std::vector<Object> objs;
+    while (steady_clock::now() < t_end) {
+        auto t0 = steady_clock::now();
+        if (governor.update()) {
+            governor.log_transition(std::cout, "soc");
+            std::lock_guard<std::mutex> lock(run.mutex);
+            run.transitions++;
+            run.max_level = std::max(run.max_level, governor.level_index());
+        }
+        if (governor.level_index() != governor_level) {
+            governor_level = governor.level_index();
+            yolo.set_num_threads(governor.level().num_threads);
+            res_ctrl.set_size_cap(governor.level().max_size);
+        }
+        yolo.set_target_size(res_ctrl.size());
+        yolo.detect(img, objs, 0.35f, 0.45f);
+        double ms = duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0;
+        {
+            std::lock_guard<std::mutex> lock(run.mutex);
+            run.latency_ms.push_back(ms);
+            run.frames++;
+        }
+        int interval = std::max(33, governor.frame_interval_ms());
+        std::this_thread::sleep_until(t0 + milliseconds(interval));
+    }
+}
+
+// runs two cameras for minutes, one line per minute; returns frames per second over the last half
+static double thermal_run(const char* model, const cv::Mat& img, float limit_c, int minutes)
+{
+    SysfsThermal thermal(env_str("YOLO_SYSFS_ROOT", "/sys"));
+    ThermalRun run;
+    ThermalGovernor governor(env_str("YOLO_SYSFS_ROOT", "/sys"), limit_c, YoloV8::default_option(model, 2).num_threads,
+                             candidate_sizes({320, 416, 512, 640}, 640), 30.f);
+    std::vector<std::thread> cams;
+    for (int c = 0; c < 2; c++)
+        cams.emplace_back(thermal_camera, model, std::cref(img), std::ref(governor), minutes * 60, std::ref(run));
+
+    long long frames_second_half = 0;
+    float max_temp = 0.f;
+    int throttled_minutes = 0;
+    for (int m = 1; m <= minutes; m++) {
+        std::this_thread::sleep_for(std::chrono::seconds(60));
+
+        std::vector<double> lat;
+        {
+            std::lock_guard<std::mutex> lock(run.mutex);
+            lat.swap(run.latency_ms);
+        }
+        std::sort(lat.begin(), lat.end());
+        ThermalSample ts = {};
+        thermal.read(ts);
+        max_temp = std::max(max_temp, ts.temp_c);
+        bool throttled = (ts.throttled & 0x4) || (ts.max_khz > 0 && ts.cur_khz < ts.max_khz * 0.9);
+        throttled_minutes += throttled;
+        if (m > minutes / 2)
+            frames_second_half += lat.size();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[THERMAL] governor " << (limit_c > 0.f ? "on " : "off") << "  min " << std::setw(2) << m
+                  << "  fps " << std::setw(5) << lat.size() / 60.0
+                  << "  p50 " << std::setw(6) << (lat.empty() ? 0.0 : lat[lat.size() / 2])
+                  << "  p99 " << std::setw(6) << (lat.empty() ? 0.0 : lat[lat.size() * 99 / 100]) << " ms"
+                  << "  " << ts.temp_c << "C  " << ts.cur_khz / 1000 << " MHz  throttled 0x" << std::hex << ts.throttled << std::dec
+                  << std::endl;
+    }
+    for (auto& t : cams)
+        t.join();
+    if (governor.enabled())
+        governor.report(std::cout, "soc");
+
+    int half_minutes = minutes - minutes / 2;
+    double sustained = frames_second_half / (half_minutes * 60.0);
+    std::cout << std::fixed << std::setprecision(1)
+              << "[THERMAL] governor " << (limit_c > 0.f ? "on " : "off") << "  sustained fps " << sustained
+              << " (last " << half_minutes << " min, 2 cameras)  max " << max_temp << "C  throttled in "
+              << throttled_minutes << "/" << minutes << " min  transitions " << run.transitions
+              << "  deepest level " << run.max_level << std::endl;
+    return sustained;
+}
+
+static int bench_thermal(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " thermal <model> [minutes=30] [temp limit=75] [image]\n";
+        return -1;
+    }
+    int minutes = (argc > 3) ? std::max(2, atoi(argv[3])) : 30;
+    float limit_c = (argc > 4) ? (float)atof(argv[4]) : 75.f;
+    std::vector<cv::Mat> images = load_images(argc, argv, 5);
+
+    SysfsThermal thermal(env_str("YOLO_SYSFS_ROOT", "/sys"));
+    ThermalSample start = {};
+    if (!thermal.read(start)) {
+        std::cerr << "[ERR] No CPU temperature in sysfs, set YOLO_SYSFS_ROOT" << std::endl;
+        return -1;
+    }
+
+    double off = thermal_run(argv[2], images[0], 0.f, minutes);
+
+    // let the board cool back to where the first run started, at most 15 minutes
+    ThermalSample ts = {};
+    for (int i = 0; i < 90 && thermal.read(ts) && ts.temp_c > start.temp_c + 2.f; i++)
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    std::cout << "[THERMAL] cooled to " << ts.temp_c << "C (started at " << start.temp_c << "C)" << std::endl;
+
+    double on = thermal_run(argv[2], images[0], limit_c, minutes);
+
+    std::cout << std::fixed << std::setprecision(1) << "[THERMAL] sustained fps off " << off << ", on " << on
+              << " (" << std::showpos << (off > 0.0 ? 100.0 * (on - off) / off : 0.0) << std::noshowpos << "%)" << std::endl;
+    return 0;
+}
+
+// frames at 30 fps with detect() cost growing with input pixels, base_ms at 640, +-10% noise
+struct ResolutionPhase
+{
+    const char* name;
+    float base_ms;
+    int frames;
+    int expected; // size the controller must hold once settled
+};
+
+static int bench_resolution(int argc, char** argv)
+{
+    const float budget_ms = 50.f;
+    // an hour cool, ten minutes throttled (640 over budget, 512 fits), then cool again
+    const ResolutionPhase phases[] = {
+        {"cool", 35.f, 30 * 3600, 640},
+        {"hot", 60.f, 30 * 600, 512},
+        {"cool again", 35.f, 30 * 600, 640},
+    };
+    // settled after this many frames of a phase
+    const int settle = 300;
+
+    ResolutionController ctrl({320, 416, 512, 640}, 640, budget_ms);
+    uint32_t rng = 12345;
+    int failed = 0;
+    for (const ResolutionPhase& p : phases) {
+        std::map<int, int> settled_frames;
+        int changes = 0;
+        for (int i = 0; i < p.frames; i++) {
+            int size = ctrl.size();
+            rng = rng * 1664525u + 1013904223u;
+            float noise = 0.9f + 0.2f * (rng >> 8) / 16777216.f;
+            float r = size / 640.f;
+            if (ctrl.update(p.base_ms * r * r * noise) != size)
+                changes++;
+            if (i >= settle)
+                settled_frames[ctrl.size()]++;
+        }
+
+        int at_expected = settled_frames[p.expected];
+        int settled_total = p.frames - settle;
+        bool ok = at_expected == settled_total;
+        failed += !ok;
+
+        std::cout << "[RES] " << std::setw(10) << std::left << p.name << std::right << "  640 costs " << p.base_ms
+                  << " ms  size changes " << std::setw(4) << changes << "  settled at " << p.expected << " for "
+                  << at_expected << "/" << settled_total << " frames  " << (ok ? "ok" : "FAIL") << std::endl;
+    }
+    ctrl.report(std::cout, "replay");
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = (argc > 1) ? argv[1] : "";
+
+    if (mode == "prune") return bench_prune(argc, argv);
+    if (mode == "roi") return bench_roi(argc, argv);
+    if (mode == "tiles") return bench_tiles(argc, argv);
+    if (mode == "framebus") return bench_framebus(argc, argv);
+    if (mode == "metrics") return bench_metrics(argc, argv);
+    if (mode == "trace") return bench_trace(argc, argv);
+    if (mode == "startup") return bench_startup(argc, argv);
+    if (mode == "thermal") return bench_thermal(argc, argv);
+    if (mode == "resolution") return bench_resolution(argc, argv);
+
+    std::cerr << "usage: " << argv[0] << " prune|roi|tiles|framebus|metrics|trace|startup|thermal|resolution ...\n";
+    return -1;
+}
@@ -1,10 +1,28 @@
 // yolov8dualv2.cpp
 // Dual-camera YOLOv8 headless version (fixed names cam1, cam2)
+// Adaptive input size: YOLO_LATENCY_BUDGET_MS=<ms> [YOLO_SIZES=320,416]
+// Regions of interest: $YOLO_ROI_DIR/cam1.roi (default ./cam1.roi), see roi_mask.h
+// High resolution: YOLO_CAPTURE_W=1920 YOLO_CAPTURE_H=1080 YOLO_TILE_SIZE=416 [YOLO_MOTION=1]
+// Live preview: YOLO_PREVIEW_PORT=8080, cam1 on 8080 and cam2 on 8081
+// Prometheus metrics: YOLO_METRICS_PORT=9464, served on /metrics
+// Frame tracing: YOLO_TRACE=trace.json, written on Ctrl-C
+// Startup: YOLO_WARMUP=<runs> blank inferences before the camera opens (default 1)
+// Thermal governor: YOLO_TEMP_LIMIT=75 [YOLO_SYSFS_ROOT=/sys]
 
 #include "yoloV8.h"
+#include "resolution_controller.h"
+#include "roi_mask.h"
+#include "motion_mask.h"
+#include "mjpeg_server.h"
+#include "metrics.h"
+#include "frame_trace.h"
+#include "thermal_governor.h"
+#include "env_config.h"
 #include <opencv2/opencv.hpp>
 #include <chrono>
+#include <csignal>
 #include <thread>
+#include <functional>
 #include <atomic>
 #include <filesystem>
 #include <fstream>
@@ -20,6 +38,7 @@ struct PersonInfo {
 };
 
 std::atomic<bool> stop_all(false);
+const high_resolution_clock::time_point t_process_start = high_resolution_clock::now();
 
 long long now_ms() {
     return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
@@ -37,7 +56,7 @@ std::string ts_to_str(long long ms) {
 
 std::string make_json(const std::string& cam_name, int human_count,
                       const std::vector<PersonInfo>& persons,
-                      double capture_ms, double infer_ms, double total_ms, long long ts_ms)
+                      double capture_ms, double infer_ms, int input_size, double total_ms, long long ts_ms)
 {
     std::ostringstream j;
     j << "{";
@@ -47,6 +66,7 @@ std::string make_json(const std::string& cam_name, int human_count,
     j << "\"human_count\":" << human_count << ",";
     j << "\"capture_ms\":" << std::fixed << std::setprecision(2) << capture_ms << ",";
     j << "\"infer_ms\":" << infer_ms << ",";
+    j << "\"input_size\":" << input_size << ",";
     j << "\"total_ms\":" << total_ms << ",";
     j << "\"persons\":[";
     for (size_t i = 0; i < persons.size(); ++i) {
@@ -59,8 +79,8 @@ std::string make_json(const std::string& cam_name, int human_count,
     return j.str();
 }
 
-void camera_thread_func(const std::string cam_dev, const std::string cam_name,
-                        int target_size = 416, float conf_thresh = 0.35f)
+void camera_thread_func(const std::string cam_dev, const std::string cam_name, ThermalGovernor& governor,
+                        int target_size = 416, float conf_thresh = 0.35f, int preview_port = 0)
 {
     try {
         fs::create_directories("detections");
@@ -76,11 +96,25 @@ void camera_thread_func(const std::string cam_dev, const std::string cam_name,
         bool first_entry = true;
 
         YoloV8 yolo;
-        yolo.load(target_size);
+        if (yolo.load(target_size, env_str("YOLO_MODEL", "yolov8n").c_str(), 2) != 0) {  // two cameras share the cores
+            std::cerr << "[ERR] Cannot load model for " << cam_name << "\n";
+            return;
+        }
+        yolo.warmup(env_int("YOLO_CAPTURE_W", 640), env_int("YOLO_CAPTURE_H", 480), env_int("YOLO_WARMUP", 1));
+        bool first_detection = true;
+
+        ResolutionController res_ctrl(env_int_list("YOLO_SIZES", {320, 416, 512, 640}), target_size,
+                                      env_float("YOLO_LATENCY_BUDGET_MS", 0.f));
+
+        // shared with the other camera, applied here whenever its level changes
+        int governor_level = 0;
+
+        ThreadMetrics* metrics = metrics_registry().add_thread(cam_name);
+        trace_thread_name(cam_name);
 
         cv::VideoCapture cap(cam_dev, cv::CAP_V4L2);
-        cap.set(cv::CAP_PROP_FRAME_WIDTH, 640);
-        cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
+        cap.set(cv::CAP_PROP_FRAME_WIDTH, env_int("YOLO_CAPTURE_W", 640));
+        cap.set(cv::CAP_PROP_FRAME_HEIGHT, env_int("YOLO_CAPTURE_H", 480));
         cap.set(cv::CAP_PROP_FPS, 30);
 
         if (!cap.isOpened()) {
@@ -90,25 +124,91 @@ void camera_thread_func(const std::string cam_dev, const std::string cam_name,
 
         std::cout << "[INFO] Camera " << cam_name << " (" << cam_dev << ") started\n";
 
+        RoiMask roi;
+        bool roi_loaded = false;
+
+        int tile_size = env_int("YOLO_TILE_SIZE", 0);
+        bool use_motion = env_int("YOLO_MOTION", 0) != 0;
+        MotionMask motion;
+
+        MjpegServer preview;
+        if (preview_port > 0 && !preview.start(preview_port))
+            std::cerr << "[ERR] Cannot listen on preview port " << preview_port << "\n";
+
         cv::Mat frame;
         int frame_count = 0;
         auto t_last = high_resolution_clock::now();
+        auto t_last_report = t_last;
 
         while (!stop_all) {
             auto t0 = high_resolution_clock::now();
+            int64_t tr_capture = trace_enabled() ? trace_now_ns() : 0;
             if (!cap.read(frame) || frame.empty()) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(2));
                 continue;
             }
+            uint64_t frame_id = trace_new_frame();
+            if (frame_id)
+                trace_complete("cap_read", frame_id, tr_capture, trace_now_ns());
 
             auto t_cap = high_resolution_clock::now();
             double capture_ms = duration_cast<microseconds>(t_cap - t0).count() / 1000.0;
+            metrics->record(STAGE_CAPTURE, capture_ms);
+
+            if (!roi_loaded) {
+                roi_loaded = true;
+                std::string roi_path = env_str("YOLO_ROI_DIR", ".") + "/" + cam_name + ".roi";
+                if (roi.load(roi_path, frame.cols, frame.rows)) {
+                    const cv::Rect& b = roi.bounds();
+                    std::cout << "[ROI " << cam_name << "] crop " << b.width << "x" << b.height << " at " << b.x << "," << b.y
+                              << " = " << std::fixed << std::setprecision(1) << 100.0 * roi.crop_fraction()
+                              << "% of frame pixels, input " << yolo.region_target_size(frame.cols, frame.rows, b)
+                              << " of " << target_size << "\n";
+                }
+            }
 
+            if (governor.update())
+                governor.log_transition(std::cout, "soc");
+            if (governor.level_index() != governor_level) {
+                governor_level = governor.level_index();
+                yolo.set_num_threads(governor.level().num_threads);
+                res_ctrl.set_size_cap(governor.level().max_size);
+            }
+
+            int input_size = res_ctrl.size();
+            yolo.set_target_size(input_size);
             std::vector<Object> objs;
             auto t_infer0 = high_resolution_clock::now();
-            yolo.detect(frame, objs, conf_thresh, 0.45f);
+            int64_t tr_detect = frame_id ? trace_now_ns() : 0;
+            if (tile_size > 0) {
+                const cv::Mat& active = use_motion ? motion.update(frame, roi.mask()) : roi.mask();
+                yolo.detect_tiled(frame, objs, tile_size, 0.2f, active, conf_thresh, 0.45f);
+            } else {
+                yolo.detect(frame, roi.bounds(), objs, conf_thresh, 0.45f);
+            }
+            roi.filter(objs);
             auto t_infer1 = high_resolution_clock::now();
             double infer_ms = duration_cast<microseconds>(t_infer1 - t_infer0).count() / 1000.0;
+            if (frame_id) {
+                const DetectTimings& dt = yolo.last_timings();
+                trace_complete("detect", frame_id, tr_detect, trace_now_ns());
+                trace_sequence(frame_id, tr_detect, {{"preprocess", dt.preprocess_ms}, {"inference", dt.inference_ms},
+                                                     {"decode", dt.decode_ms}, {"nms", dt.nms_ms}});
+            }
+            res_ctrl.update(infer_ms);
+
+            if (first_detection) {
+                first_detection = false;
+                std::cout << "[INFO] " << cam_name << " first detection " << std::fixed << std::setprecision(0)
+                          << duration_cast<microseconds>(t_infer1 - t_process_start).count() / 1000.0 << " ms after start (model "
+                          << yolo.model_source() << " " << yolo.load_ms() << " ms)\n";
+            }
+
+            const DetectTimings& dt = yolo.last_timings();
+            metrics->record(STAGE_PREPROCESS, dt.preprocess_ms);
+            metrics->record(STAGE_INFERENCE, dt.inference_ms);
+            metrics->record(STAGE_DECODE, dt.decode_ms);
+            metrics->record(STAGE_NMS, dt.nms_ms);
 
             std::vector<PersonInfo> persons;
             for (auto& o : objs) {
@@ -117,26 +217,45 @@ void camera_thread_func(const std::string cam_dev, const std::string cam_name,
                 }
             }
 
+            if (preview.has_viewers())
+                preview.submit(frame, objs, cam_name + cv::format("  size: %d", input_size));
+
             if (!persons.empty()) {
+                TraceSpan trace_log("log_write", frame_id);
                 long long ts_ms = now_ms();
                 double total_ms = duration_cast<microseconds>(high_resolution_clock::now() - t0).count() / 1000.0;
-                std::string js = make_json(cam_name, persons.size(), persons, capture_ms, infer_ms, total_ms, ts_ms);
+                std::string js = make_json(cam_name, persons.size(), persons, capture_ms, infer_ms, input_size, total_ms, ts_ms);
                 if (!first_entry) jf << ",\n";
                 first_entry = false;
                 jf << js;
                 jf.flush();
+                metrics->record(STAGE_LOG_WRITE, duration_cast<microseconds>(high_resolution_clock::now() - t0).count() / 1000.0 - total_ms);
             }
+            metrics->count(COUNTER_FRAMES);
+            metrics->count(COUNTER_HUMANS, persons.size());
 
             frame_count++;
             auto now = high_resolution_clock::now();
             if (duration_cast<seconds>(now - t_last).count() >= 1) {
                 double fps = frame_count / std::max(1.0, duration_cast<milliseconds>(now - t_last).count() / 1000.0);
                 std::cout << "[CAM " << cam_name << "] FPS:" << std::fixed << std::setprecision(1)
-                          << fps << " infer:" << infer_ms << "ms\n";
+                          << fps << " infer:" << infer_ms << "ms size:" << input_size;
+                if (tile_size > 0)
+                    std::cout << " tiles:" << yolo.last_tiles_run() << "/" << yolo.last_tiles_total();
+                std::cout << "\n";
                 frame_count = 0;
                 t_last = now;
             }
+            if (res_ctrl.enabled() && duration_cast<seconds>(now - t_last_report).count() >= 60) {
+                res_ctrl.report(std::cout, cam_name);
+                t_last_report = now;
+            }
+
+            int interval_ms = governor.frame_interval_ms();
+            if (interval_ms > 0)
+                std::this_thread::sleep_until(t0 + milliseconds(interval_ms));
         }
+        res_ctrl.report(std::cout, cam_name);
 
         jf << "\n]\n";
         jf.close();
@@ -155,8 +274,27 @@ int main()
 
     stop_all = false;
 
-    std::thread t0(camera_thread_func, cam0, name0, 416, 0.35f);
-    std::thread t1(camera_thread_func, cam1, name1, 416, 0.35f);
+    std::signal(SIGINT, [](int) { stop_all = true; });
+    std::signal(SIGTERM, [](int) { stop_all = true; });
+
+    std::string trace_path = env_str("YOLO_TRACE", "");
+    if (!trace_path.empty())
+        trace_start(env_int("YOLO_TRACE_EVENTS", 1 << 16));
+
+    int preview_port = env_int("YOLO_PREVIEW_PORT", 0);
+
+    MetricsServer metrics_server;
+    int metrics_port = env_int("YOLO_METRICS_PORT", 0);
+    if (metrics_port > 0 && !metrics_server.start(metrics_port))
+        std::cerr << "[ERR] Cannot listen on metrics port " << metrics_port << "\n";
+
+    // one governor for both cameras: they share the SoC, so they step together
+    ThermalGovernor governor(env_str("YOLO_SYSFS_ROOT", "/sys"), env_float("YOLO_TEMP_LIMIT", 0.f),
+                             YoloV8::default_option(env_str("YOLO_MODEL", "yolov8n").c_str(), 2).num_threads,
+                             candidate_sizes(env_int_list("YOLO_SIZES", {320, 416, 512, 640}), 416), 30.f);
+
+    std::thread t0(camera_thread_func, cam0, name0, std::ref(governor), 416, 0.35f, preview_port);
+    std::thread t1(camera_thread_func, cam1, name1, std::ref(governor), 416, 0.35f, preview_port > 0 ? preview_port + 1 : 0);
 
     std::cout << "Press Ctrl-C to stop\n";
 
@@ -164,5 +302,13 @@ int main()
     t1.join();
 
     stop_all = true;
+    if (governor.enabled())
+        governor.report(std::cout, "soc");
+
+    if (!trace_path.empty()) {
+        trace_stop();
+        if (!trace_dump(trace_path))
+            std::cerr << "[ERR] Cannot write trace " << trace_path << "\n";
+    }
     return 0;
 }
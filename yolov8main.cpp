@@ -1,12 +1,36 @@
+// yolov8main.cpp
+// Single camera detector; the annotated preview is served as MJPEG instead of a
+// window: YOLO_PREVIEW_PORT=8080 ./YoloV8, then open http://<pi>:8080/ (off when unset).
+// Compile with: g++ yoloV8.cpp ncnn_profile.cpp resolution_controller.cpp http_util.cpp mjpeg_server.cpp yolov8main.cpp -o YoloV8 `pkg-config --cflags --libs opencv4` -I /home/pi/ncnn/build/install/include/ncnn -L /home/pi/ncnn/build/install/lib -lncnn -fopenmp -lpthread -O3 -std=c++17
+
 #include "yoloV8.h"
+#include "resolution_controller.h"
+#include "mjpeg_server.h"
+#include "env_config.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+
+std::atomic<bool> stop_all(false);
 
 int main(int argc, char** argv)
 {
+    auto t_start = std::chrono::steady_clock::now();
+
     YoloV8 yolo;
-    yolo.load(640);  // target input size
+    if (yolo.load(640, env_str("YOLO_MODEL", "yolov8n").c_str()) != 0) {  // target input size, YOLO_MODEL=yolov8n_person for a pruned head
+        std::cerr << "❌ Cannot load model" << std::endl;
+        return -1;
+    }
+    yolo.warmup(640, 480, env_int("YOLO_WARMUP", 1));  // first real frame runs at full speed
+    bool first_detection = true;
+
+    // YOLO_LATENCY_BUDGET_MS=<ms> lets the input size drop below 640 when frames run late
+    ResolutionController res_ctrl(env_int_list("YOLO_SIZES", {320, 416, 512, 640}), 640,
+                                  env_float("YOLO_LATENCY_BUDGET_MS", 0.f));
 
     std::string cam_path = (argc > 1) ? argv[1] : "/dev/video0";
     cv::VideoCapture cap(cam_path, cv::CAP_V4L2);
@@ -20,16 +44,40 @@ int main(int argc, char** argv)
     }
 
     std::cout << "📷 Camera opened: " << cam_path << std::endl;
+
+    // drawing and JPEG encoding happen on the server's thread, and only while someone watches
+    MjpegServer preview;
+    int preview_port = env_int("YOLO_PREVIEW_PORT", 0);
+    if (preview_port > 0) {
+        if (preview.start(preview_port))
+            std::cout << "[INFO] Preview on http://0.0.0.0:" << preview_port << "/" << std::endl;
+        else
+            std::cerr << "[ERR] Cannot listen on preview port " << preview_port << std::endl;
+    }
+
+    // Ctrl-C / kill ends the loop so the resolution report below still runs
+    std::signal(SIGINT, [](int) { stop_all = true; });
+    std::signal(SIGTERM, [](int) { stop_all = true; });
+
     cv::Mat frame;
-    while (true)
+    while (!stop_all)
     {
         cap >> frame;
         if (frame.empty()) continue;
 
         auto start = std::chrono::steady_clock::now();
 
+        int input_size = res_ctrl.size();
+        yolo.set_target_size(input_size);
         std::vector<Object> objects;
         yolo.detect(frame, objects, 0.35f, 0.45f);  // conf, nms
+        res_ctrl.update(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0f);
+
+        if (first_detection) {
+            first_detection = false;
+            std::cout << "[INFO] First detection " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t_start).count()
+                      << " ms after start (model " << yolo.model_source() << ")" << std::endl;
+        }
 
         // optional: only show humans
         std::vector<Object> persons;
@@ -37,17 +85,14 @@ int main(int argc, char** argv)
             if (obj.label == 0)
                 persons.push_back(obj);
 
-        yolo.draw(frame, persons);
-
         auto end = std::chrono::steady_clock::now();
-        double fps = 1000.0 / std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-
-        cv::putText(frame, cv::format("FPS: %.1f", fps), cv::Point(20, 40),
-                    cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 0, 0), 2);
+        double fps = 1000.0 / std::max<long long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
 
-        cv::imshow("YOLOv8 NCNN Camera", frame);
-        if (cv::waitKey(1) == 27) break;  // ESC
+        if (preview.has_viewers())
+            preview.submit(frame, persons, cv::format("FPS: %.1f  size: %d", fps, input_size));
     }
 
+    res_ctrl.report(std::cout, cam_path);
+
     return 0;
 }
@@ -0,0 +1,253 @@
+// yolov8prune.cpp
+// Model surgery for the YoloV8 ncnn head: keeps only the classification
+// channels of the selected COCO classes, so the three class convolutions and
+// the output rows shrink from 64 + 80 to 64 + n floats per anchor.
+// Writes <out>.param, <out>.bin and <out>.classes (original class ids, read by
+// YoloV8::load to map labels back).
+// Compile with: g++ yolov8prune.cpp -o YoloV8Prune -O2 -std=c++17
+// Usage: ./YoloV8Prune yolov8n yolov8n_person [classes=0]   e.g. classes 0,2,7
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct LayerLine {
+    std::string type;
+    std::string name;
+    std::vector<std::string> bottoms;
+    std::vector<std::string> tops;
+    std::vector<std::pair<int, std::string>> params; // id -> raw value text, order kept
+
+    std::string get(int id, const std::string& def = "") const {
+        for (auto& p : params)
+            if (p.first == id) return p.second;
+        return def;
+    }
+    void set(int id, const std::string& v) {
+        for (auto& p : params)
+            if (p.first == id) { p.second = v; return; }
+        params.push_back({ id, v });
+    }
+};
+
+// layers in these models that carry no weights in the .bin
+static const std::set<std::string> weightless = {
+    "Input", "Split", "Concat", "Crop", "Swish", "Sigmoid", "ReLU", "BinaryOp",
+    "Interp", "Permute", "Pooling", "Reshape", "Softmax", "Slice", "Flatten", "Noop"
+};
+
+static const uint32_t tag_fp16 = 0x01306B47;
+static const uint32_t tag_fp32_raw = 0x0002C056;
+
+static bool parse_param(const std::string& path, std::string& magic, int& blob_count, std::vector<LayerLine>& layers)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) return false;
+
+    int layer_count = 0;
+    if (!(f >> magic >> layer_count >> blob_count)) return false;
+
+    for (int i = 0; i < layer_count; i++) {
+        LayerLine l;
+        int nb = 0, nt = 0;
+        if (!(f >> l.type >> l.name >> nb >> nt)) return false;
+        l.bottoms.resize(nb);
+        l.tops.resize(nt);
+        for (auto& b : l.bottoms) f >> b;
+        for (auto& t : l.tops) f >> t;
+
+        std::string rest;
+        std::getline(f, rest);
+        std::istringstream kv(rest);
+        std::string tok;
+        while (kv >> tok) {
+            size_t eq = tok.find('=');
+            if (eq == std::string::npos) return false;
+            l.params.push_back({ atoi(tok.substr(0, eq).c_str()), tok.substr(eq + 1) });
+        }
+        layers.push_back(l);
+    }
+    return true;
+}
+
+static bool write_param(const std::string& path, const std::string& magic, int blob_count, const std::vector<LayerLine>& layers)
+{
+    std::ofstream f(path);
+    if (!f.is_open()) return false;
+
+    f << magic << "\n" << layers.size() << " " << blob_count << "\n";
+    for (auto& l : layers) {
+        std::string type = l.type, name = l.name;
+        type.resize(std::max<size_t>(type.size() + 1, 25), ' ');
+        name.resize(std::max<size_t>(name.size() + 1, 25), ' ');
+        f << type << name << l.bottoms.size() << " " << l.tops.size();
+        for (auto& b : l.bottoms) f << " " << b;
+        for (auto& t : l.tops) f << " " << t;
+        for (auto& p : l.params) f << " " << p.first << "=" << p.second;
+        f << "\n";
+    }
+    return f.good();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <in model> <out model> [classes=0]\n";
+        return -1;
+    }
+    std::string in = argv[1], out = argv[2];
+
+    std::vector<int> keep;
+    {
+        std::stringstream ss((argc > 3) ? argv[3] : "0");
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty()) keep.push_back(atoi(item.c_str()));
+    }
+    // rows stay in COCO order, each class once
+    std::sort(keep.begin(), keep.end());
+    keep.erase(std::unique(keep.begin(), keep.end()), keep.end());
+    if (keep.empty()) {
+        std::cerr << "[ERR] No classes to keep\n";
+        return -1;
+    }
+
+    std::string magic;
+    int blob_count = 0;
+    std::vector<LayerLine> layers;
+    if (!parse_param(in + ".param", magic, blob_count, layers)) {
+        std::cerr << "[ERR] Cannot parse " << in << ".param\n";
+        return -1;
+    }
+
+    // follow the head backwards: Reshape(1=144) <- Concat(box, cls) <- cls Convolution
+    std::map<std::string, int> producer;
+    for (int i = 0; i < (int)layers.size(); i++)
+        for (auto& t : layers[i].tops) producer[t] = i;
+
+    const int reg_ch = 64; // 4 sides x reg_max 16
+    int num_class = 0;
+    std::set<int> cls_convs;
+    std::vector<int> reshapes;
+    for (int i = 0; i < (int)layers.size(); i++) {
+        LayerLine& l = layers[i];
+        if (l.type != "Reshape" || atoi(l.get(1, "0").c_str()) <= reg_ch) continue;
+
+        const LayerLine& cat = layers[producer[l.bottoms[0]]];
+        if (cat.type != "Concat" || cat.bottoms.size() != 2) continue;
+
+        int conv = producer[cat.bottoms[1]];
+        if (layers[conv].type != "Convolution") continue;
+
+        num_class = atoi(layers[conv].get(0).c_str());
+        cls_convs.insert(conv);
+        reshapes.push_back(i);
+    }
+
+    if (cls_convs.empty()) {
+        std::cerr << "[ERR] No YoloV8 class branch found in " << in << ".param\n";
+        return -1;
+    }
+    for (int c : keep) {
+        if (c < 0 || c >= num_class) {
+            std::cerr << "[ERR] Class " << c << " out of range, model has " << num_class << "\n";
+            return -1;
+        }
+    }
+
+    std::ifstream fin(in + ".bin", std::ios::binary);
+    std::ofstream fout(out + ".bin", std::ios::binary);
+    if (!fin.is_open() || !fout.is_open()) {
+        std::cerr << "[ERR] Cannot open " << in << ".bin or " << out << ".bin\n";
+        return -1;
+    }
+
+    size_t bytes_in = 0, bytes_out = 0;
+    for (int i = 0; i < (int)layers.size(); i++) {
+        LayerLine& l = layers[i];
+        if (weightless.count(l.type)) continue;
+        if (l.type != "Convolution" || !l.get(8).empty()) {
+            std::cerr << "[ERR] " << l.type << " " << l.name << " has a weight layout this tool does not handle\n";
+            return -1;
+        }
+
+        int num_output = atoi(l.get(0).c_str());
+        int weight_size = atoi(l.get(6).c_str());
+        bool bias = atoi(l.get(5, "0").c_str()) != 0;
+
+        // weight_data is stored with a 4 byte type tag, bias_data is raw fp32
+        uint32_t tag = 0;
+        fin.read((char*)&tag, 4);
+        size_t elem = 0;
+        if (tag == 0 || tag == tag_fp32_raw) elem = 4;
+        else if (tag == tag_fp16) elem = 2;
+        else {
+            std::cerr << "[ERR] " << l.name << ": quantized weights (tag 0x" << std::hex << tag << ") not supported\n";
+            return -1;
+        }
+
+        size_t weight_bytes = (weight_size * elem + 3) / 4 * 4;
+        std::vector<char> w(weight_bytes);
+        std::vector<char> b(bias ? num_output * 4 : 0);
+        fin.read(w.data(), w.size());
+        fin.read(b.data(), b.size());
+        if (!fin) {
+            std::cerr << "[ERR] " << in << ".bin is shorter than the param describes\n";
+            return -1;
+        }
+        bytes_in += 4 + w.size() + b.size();
+
+        if (cls_convs.count(i)) {
+            // weights are [num_output][inch * k * k], keep the selected rows
+            size_t row = (size_t)(weight_size / num_output) * elem;
+            std::vector<char> nw, nb;
+            for (int c : keep) {
+                nw.insert(nw.end(), w.begin() + c * row, w.begin() + (c + 1) * row);
+                if (bias) nb.insert(nb.end(), b.begin() + c * 4, b.begin() + (c + 1) * 4);
+            }
+            nw.resize((nw.size() + 3) / 4 * 4, 0);
+            w.swap(nw);
+            b.swap(nb);
+
+            l.set(0, std::to_string(keep.size()));
+            l.set(6, std::to_string((weight_size / num_output) * (int)keep.size()));
+        }
+
+        fout.write((const char*)&tag, 4);
+        fout.write(w.data(), w.size());
+        fout.write(b.data(), b.size());
+        bytes_out += 4 + w.size() + b.size();
+    }
+
+    fin.peek();
+    if (!fin.eof()) {
+        std::cerr << "[ERR] " << in << ".bin has trailing data, param/bin mismatch?\n";
+        return -1;
+    }
+
+    for (int r : reshapes)
+        layers[r].set(1, std::to_string(reg_ch + (int)keep.size()));
+
+    if (!write_param(out + ".param", magic, blob_count, layers) || !fout.good()) {
+        std::cerr << "[ERR] Cannot write " << out << ".param/.bin\n";
+        return -1;
+    }
+
+    std::ofstream fc(out + ".classes");
+    for (int c : keep) fc << c << "\n";
+
+    std::cout << "[PRUNE] " << in << " -> " << out << ": " << cls_convs.size() << " class convs, "
+              << num_class << " -> " << keep.size() << " classes, output row "
+              << reg_ch + num_class << " -> " << reg_ch + keep.size() << " floats, bin "
+              << bytes_in << " -> " << bytes_out << " bytes\n";
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// yolov8tune.cpp
+// Benchmarks ncnn option combinations for this machine and model and stores the
+// fastest in yolov8.profile, which YoloV8::load() picks up on the next start.
+// Compile with: g++ yoloV8.cpp ncnn_profile.cpp yolov8tune.cpp -o YoloV8Tune `pkg-config --cflags --libs opencv4` -I /home/pi/ncnn/build/install/include/ncnn -L /home/pi/ncnn/build/install/lib -lncnn -fopenmp -lpthread -O3 -std=c++17
+// Usage: ./YoloV8Tune [model=yolov8n] [target_size=640] [image.jpg] [runs=10] [nets=1]
+// nets=2 tunes for the dual camera binaries, two nets inferring at the same time.
+// Run it on an idle board; the search takes a few minutes on a Pi 4.
+
+#include "yoloV8.h"
+#include "ncnn_profile.h"
+#include <opencv2/opencv.hpp>
+#include <cpu.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono;
+
+static cv::Mat make_test_frame()
+{
+    // textured frame so every layer does real work, 640x480 like the cameras
+    cv::Mat frame(480, 640, CV_8UC3);
+    for (int y = 0; y < frame.rows; y++) {
+        unsigned char* p = frame.ptr<unsigned char>(y);
+        for (int x = 0; x < frame.cols * 3; x++)
+            p[x] = (unsigned char)((x * 7 + y * 13 + (x * y) % 31) & 0xff);
+    }
+    return frame;
+}
+
+// a change must beat the current best by this much, so timing noise does not pick options
+static const float min_gain = 0.03f;
+
+// median detect() time in ms with nets copies of the model inferring at the
+// same time, each with opt, or a huge value if the model fails to load
+static float bench(const ncnn::Option& opt, const char* model, int target_size, const cv::Mat& frame, int runs, int nets)
+{
+    std::vector<std::unique_ptr<YoloV8>> yolos;
+    for (int n = 0; n < nets; n++) {
+        yolos.emplace_back(new YoloV8);
+        if (yolos.back()->load(target_size, opt, model) != 0)
+            return 1e9f;
+    }
+
+    std::vector<std::vector<float>> ms(nets);
+    std::vector<std::thread> threads;
+    for (int n = 0; n < nets; n++) {
+        threads.emplace_back([&, n]() {
+            std::vector<Object> objs;
+            // first runs pay for pipeline creation and allocator growth
+            for (int i = 0; i < 2; i++)
+                yolos[n]->detect(frame, objs);
+
+            for (int i = 0; i < runs; i++) {
+                auto t0 = steady_clock::now();
+                yolos[n]->detect(frame, objs);
+                ms[n].push_back(duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.f);
+            }
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    std::vector<float> all;
+    for (const std::vector<float>& m : ms)
+        all.insert(all.end(), m.begin(), m.end());
+    std::sort(all.begin(), all.end());
+    return all[all.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+    const char* model = (argc > 1) ? argv[1] : "yolov8n";
+    int target_size = (argc > 2) ? atoi(argv[2]) : 640;
+    cv::Mat frame = (argc > 3) ? cv::imread(argv[3]) : make_test_frame();
+    int runs = (argc > 4) ? std::max(3, atoi(argv[4])) : 10;
+    int nets = (argc > 5) ? std::max(1, atoi(argv[5])) : 1;
+
+    if (frame.empty()) {
+        std::cerr << "[ERR] Cannot read " << argv[3] << std::endl;
+        return -1;
+    }
+
+    std::string key = machine_key(model, nets);
+    std::cout << "[TUNE] " << key << " size " << target_size << std::endl;
+
+    // baseline: what load() used before any profile existed, the cores split between the nets
+    int cores = ncnn::get_cpu_count();
+    ncnn::Option best;
+    best.num_threads = std::max(1, std::min(4, cores) / nets);
+    float best_ms = bench(best, model, target_size, frame, runs, nets);
+    float baseline_ms = best_ms;
+    std::cout << "[TUNE] baseline " << std::fixed << std::setprecision(2) << best_ms << " ms" << std::endl;
+
+    auto consider = [&](const ncnn::Option& opt, const std::string& what) {
+        float ms = bench(opt, model, target_size, frame, runs, nets);
+        bool better = ms < best_ms * (1.f - min_gain);
+        std::cout << "[TUNE] " << std::setw(28) << std::left << what << std::right
+                  << std::setw(9) << ms << " ms" << (better ? "  *" : "") << std::endl;
+        if (better) {
+            best = opt;
+            best_ms = ms;
+        }
+    };
+
+    // threads per net first, they dominate everything else
+    for (int t = 1; t <= cores; t++) {
+        if (t == best.num_threads) continue;
+        ncnn::Option opt = best;
+        opt.num_threads = t;
+        consider(opt, "num_threads=" + std::to_string(t));
+    }
+
+    // then greedily flip each switch, keeping a flip only when it is faster;
+    // a full cartesian search would be 2^7 loads per thread count
+    struct Switch { const char* name; bool ncnn::Option::*field; };
+    const Switch switches[] = {
+        {"winograd", &ncnn::Option::use_winograd_convolution},
+        {"sgemm", &ncnn::Option::use_sgemm_convolution},
+        {"packing_layout", &ncnn::Option::use_packing_layout},
+        {"fp16_packed", &ncnn::Option::use_fp16_packed},
+        {"fp16_storage", &ncnn::Option::use_fp16_storage},
+        {"fp16_arithmetic", &ncnn::Option::use_fp16_arithmetic},
+        {"lightmode", &ncnn::Option::lightmode},
+    };
+    for (const Switch& s : switches) {
+        ncnn::Option opt = best;
+        opt.*s.field = !(best.*s.field);
+        consider(opt, std::string(s.name) + "=" + std::to_string((int)(opt.*s.field)));
+    }
+
+#if defined(_OPENMP) && defined(__clang__)
+    // OpenMP spin time after each parallel region: 0 frees the cores for the
+    // other camera thread, larger values avoid wake-up latency between layers.
+    // ncnn only passes it on to clang's libomp, GCC's libgomp ignores it
+    const int blocktimes[] = {0, 20, 200};
+    for (int bt : blocktimes) {
+        if (bt == best.openmp_blocktime) continue;
+        ncnn::Option opt = best;
+        opt.openmp_blocktime = bt;
+        consider(opt, "openmp_blocktime=" + std::to_string(bt));
+    }
+#endif
+
+    NcnnProfile profile;
+    profile_from_option(best, profile);
+    profile.infer_ms = best_ms;
+
+    std::cout << "[TUNE] best " << best_ms << " ms (baseline " << baseline_ms << " ms): "
+              << profile_to_string(profile) << std::endl;
+
+    if (!save_profile(NCNN_PROFILE_PATH, key, profile)) {
+        std::cerr << "[ERR] Cannot write " << NCNN_PROFILE_PATH << std::endl;
+        return -1;
+    }
+    std::cout << "[TUNE] saved to " << NCNN_PROFILE_PATH << std::endl;
+
+    return 0;
+}